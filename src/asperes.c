@@ -22,10 +22,22 @@
 #include <time.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#endif
+
 #include "util.h"
+#include "buffer.h"
+#include "image.h"
 #include "image_io.h"
 #include "sound_io.h"
 #include "dsp.h"
+#include "stream.h"
+#include "live.h"
+#include "fft.h"
+#include "bank.h"
+#include "kernels.h"
 #include "mutil.h"
 
 //======================================================================
@@ -55,12 +67,24 @@
 #define MAX_GAMMA	2
 #define DEF_GAMMA	1
 
-enum { MODE_ANAL, MODE_SINE_SYNTH, MODE_NOISE_SYNTH };
+#define MAX_THREADS	256
+
+#define MAX_SEG_LEN	86400	// one day, in seconds
+#define MAX_BLOCK_LEN	86400
+#define DEF_APPEND_BLOCK 10	// block length of -A without -w, in seconds
+#define MAX_LATENCY	3600
+
+enum { MODE_ANAL, MODE_SINE_SYNTH, MODE_NOISE_SYNTH, MODE_BENCH, MODE_LIVE };
+enum { CHAN_FIRST, CHAN_MIX, CHAN_MS, CHAN_ALL };
 
 /* globals */
 
 double logbase;
 int32_t quiet = 0;
+int32_t freq_decim = 0;
+int32_t multirate = 0;
+int32_t threads = 1;
+double seg_len = 0.0;
 char *logname = "asperes.log";
 
 //======================================================================
@@ -70,37 +94,69 @@ char *logname = "asperes.log";
 static int use_linear = 0;
 static int help_req = 0;
 static int vers_req = 0;
+static int row_pipe = 0;
+static int direct_u8 = 0;
+static int stack_chan = 0;
+static int append = 0;
 
 static char band_per_oct_s[MUT_ARG_MAXLEN];
+static char chan_mode_s[MUT_ARG_MAXLEN];
 static char config_file[MUT_ARG_MAXLEN];
+static char fft_backend_s[MUT_ARG_MAXLEN];
+static char fft_plan_s[MUT_ARG_MAXLEN];
+static char freq_range_s[MUT_ARG_MAXLEN];
 static char gamma_corr_s[MUT_ARG_MAXLEN];
 static char img_height_s[MUT_ARG_MAXLEN];
 static char img_width_s[MUT_ARG_MAXLEN];
 static char input_file[MUT_ARG_MAXLEN];
+static char latency_s[MUT_ARG_MAXLEN];
+static char threads_s[MUT_ARG_MAXLEN];
 static char high_freq_s[MUT_ARG_MAXLEN];
 static char low_freq_s[MUT_ARG_MAXLEN];
+static char mipmap_s[MUT_ARG_MAXLEN];
 static char output_file[MUT_ARG_MAXLEN];
 static char pix_per_sec_s[MUT_ARG_MAXLEN];
+static char seg_len_s[MUT_ARG_MAXLEN];
+static char block_len_s[MUT_ARG_MAXLEN];
 static char prog_mode_s[MUT_ARG_MAXLEN];
+static char simd_s[MUT_ARG_MAXLEN];
+static char time_range_s[MUT_ARG_MAXLEN];
 static char wav_rate_s[MUT_ARG_MAXLEN];
 
 static arglist_t arglist[] =
 {
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "d", (void *) &freq_decim }, 
   { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "l", (void *) &use_linear }, 
   { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "h", (void *) &help_req }, 
   { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "q", (void *) &quiet }, 
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "u", (void *) &multirate }, 
   { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "v", (void *) &vers_req }, 
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "z", (void *) &row_pipe }, 
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "8", (void *) &direct_u8 }, 
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "S", (void *) &stack_chan }, 
+  { MUT_ARG_SWITCH, MUT_ARG_OPTIONAL, "A", (void *) &append }, 
 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "a", (void *) high_freq_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "b", (void *) band_per_oct_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "c", (void *) config_file }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "C", (void *) chan_mode_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "e", (void *) fft_plan_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "f", (void *) input_file }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "F", (void *) freq_range_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "g", (void *) gamma_corr_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "i", (void *) low_freq_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "j", (void *) threads_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "k", (void *) fft_backend_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "L", (void *) latency_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "m", (void *) prog_mode_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "M", (void *) mipmap_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "n", (void *) seg_len_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "o", (void *) output_file }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "p", (void *) pix_per_sec_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "r", (void *) wav_rate_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "s", (void *) simd_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "t", (void *) time_range_s }, 
+  { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "w", (void *) block_len_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "x", (void *) img_width_s }, 
   { MUT_ARG_PAIRED, MUT_ARG_OPTIONAL, "y", (void *) img_height_s }, 
 
@@ -111,6 +167,14 @@ static arglist_t arglist[] =
 
 static char *version = "0.3.0";
 static char *def_cfg = "asperes.ini";
+#ifdef ASPERES_FLOAT
+static char *def_wis = "asperesf.wis";	// single precision wisdom differs
+static char *def_cst = "asperesf.cst";
+#else
+static char *def_wis = "asperes.wis";
+static char *def_cst = "asperes.cst";
+#endif
+static char *def_prc = "asperes.prc";	// of the double precision build
 
 static char *help_text[] =
 {
@@ -121,11 +185,18 @@ static char *help_text[] =
   "    -v             display version number & quit"		,
   "    -q             no console output (useful for scripting)"	,
   "    -l             use linear freq scale"			,
+  "    -d             decimate the bands in the frequency domain"	,
+  "    -u             analyse the low octaves at lower sample rates"	,
+  "    -z             write the image a row at a time, never whole"	,
+  "    -8             analyse straight into an 8-bit image (2 passes)"	,
+  "    -S             stack the images of the channels into one"	,
+  "    -A             extend the image of a growing sound"		,
   "  parameters:"						,
   "    -c [name]      configuration file to use"		,
-  "    -m [mode]      program mode (anal, sine, noise)"		,
-  "    -f [name]      name of input file"			,
-  "    -o [name]      name of output file to write"		,
+  "    -m [mode]      program mode (anal, sine, noise, bench, live)"	,
+  "    -f [name]      name of input file ('-' for stdin in live mode)"	,
+  "    -C [mode]      channels to analyse (first, mix, ms, all)"	,
+  "    -o [name]      name of output file ('-' for stdout in live mode)"	,
   "    -i [float]     minimum frequency (Hz)"			,
   "    -a [float]     maximum frequency (Hz)"			,
   "    -b [int]       frequency resolution (bands per octave)"	,
@@ -133,6 +204,16 @@ static char *help_text[] =
   "    -y [int]       desired height of the spectrogram"	,
   "    -x [int]       desired width of the spectrogram"		,
   "    -g [float]     gamma-like brightness correction"		,
+  "    -n [float]     analyse in time segments of this length (s)"	,
+  "    -w [float]     stream the sound in blocks of this length (s)"	,
+  "    -L [float]     most latency of live analysis (s, 0 = any)"	,
+  "    -t [from:to]   analyse only this time range (s)"		,
+  "    -F [from:to]   analyse only the bands in this range (Hz)"	,
+  "    -M [pooling]   write a pyramid of tiles instead (max, mean)"	,
+  "    -e [mode]      FFT planning (estimate, measure, patient)"	,
+  "    -j [int]       threads for the FFTs & bands (0 = all CPUs)"	,
+  "    -k [name]      FFT backend (fftw, builtin)"		,
+  "    -s [level]     SIMD level (auto, scalar, sse2, avx2, avx512)"	,
   NULL
 };
 
@@ -161,6 +242,25 @@ static char *err_21 = "You should specify a minimum frequency.";
 static char *err_22 = "You should specify the 'band per octave' parameter.";
 static char *err_23 = "You should specify a maximum frequency.";
 static char *err_24 = "You should specify the 'pixels per second' parameter.";
+static char *err_25 = "Unknown FFT planning mode.";
+static char *err_26 = "Number of threads is out of range.";
+static char *err_27 = "Unknown SIMD level.";
+static char *err_28 = "The processor does not support this SIMD level.";
+static char *err_29 = "Unknown FFT backend.";
+static char *err_30 = "Segment length is out of range.";
+static char *err_31 = "Block length is out of range.";
+static char *err_32 = "Cannot create a temporary file.";
+static char *err_33 = "Unknown channel mode.";
+static char *err_34 = "Mid/side analysis needs a stereo sound.";
+static char *err_35 = "Latency is out of range.";
+static char *err_36 = "Latency is too short for this time resolution.";
+static char *err_37 = "Live analysis takes the first channel or the mix.";
+static char *err_38 = "Bad range, give it as from:to";
+static char *err_39 = "The time range holds no column.";
+static char *err_40 = "The frequency range holds less than two bands.";
+static char *err_41 = "Unknown pooling mode.";
+static char *err_42 = "The image is too large for a BMP file.";
+static char *err_43 = "These options don't go together.";
 
 static char *warn_1 = "WARNING: Too many parameters for vertical resolution.";
 static char *warn_2 = "Removing the parameter '-a' (maximum frequency).";
@@ -174,10 +274,23 @@ static double high_freq = 0.0;
 static double pix_per_sec = 0.0;
 static double band_per_oct = 0.0;
 static double gamma_corr = DEF_GAMMA;
+static double block_len = 0.0;
+static double latency = 0.0;
+static double time_from = 0.0;
+static double time_to = HUGE_VAL;
+static double freq_from = 0.0;
+static double freq_to = HUGE_VAL;
 
 static int32_t channels;
+static int32_t bits;
 static int32_t samplecount = 0;
 static int32_t prog_mode = PAR_UNSET;
+static int32_t fft_effort = FFT_ESTIMATE;
+static int32_t fft_backend = 0;
+static int32_t simd_level = KERN_AUTO;
+static int32_t chan_mode = CHAN_FIRST;
+static int32_t chan_given = 0;		// on the command line
+static int32_t mipmap = -1;
 static int32_t img_width = 0;
 static int32_t img_height = 0;
 static int32_t wav_rate = DEF_WAV_RATE;
@@ -185,6 +298,10 @@ static int32_t std_wav_rates[] =
 {
   8000, 11025, 22050, 44100, 48000, 96000, -1
 };
+static char *chan_names[] =	// of the channel modes, for messages
+{
+  "first", "mix", "ms", "all"
+};
 
 /* miscellaneous variables */
 
@@ -195,6 +312,13 @@ static int32_t start_time;
 static int32_t end_time;
 
 static char date[32];
+static char fft_plan_cfg[MUT_ARG_MAXLEN];
+static char wisdom_file[MUT_MAX_PATH_LEN];
+static char cost_file[MUT_MAX_PATH_LEN];
+static char precision_file[MUT_MAX_PATH_LEN];
+static char simd_cfg[MUT_ARG_MAXLEN];
+static char fft_backend_cfg[MUT_ARG_MAXLEN];
+static char chan_cfg[MUT_ARG_MAXLEN];
 
 //======================================================================
 
@@ -205,7 +329,17 @@ static config_t config[] =
   { MUT_INI_FLT, "BandPerOct", &band_per_oct, 4, 0, 0 },
   { MUT_INI_FLT, "PixPerSec",  &pix_per_sec,  6, 0, 0 },
   { MUT_INI_FLT, "GammaCorr",  &gamma_corr,   4, 0, 0 },
+  { MUT_INI_FLT, "SegmentLen", &seg_len,      8, 0, 0 },
+  { MUT_INI_FLT, "StreamBlock", &block_len,   8, 0, 0 },
+  { MUT_INI_FLT, "Latency",    &latency,      8, 0, 0 },
   { MUT_INI_INT, "WavRate",    &wav_rate,     6, 0, 0 },
+  { MUT_INI_STR, "FftPlan",    fft_plan_cfg,  MUT_ARG_MAXLEN, 0, 0 },
+  { MUT_INI_STR, "FftBackend", fft_backend_cfg, MUT_ARG_MAXLEN, 0, 0 },
+  { MUT_INI_INT, "Threads",    &threads,      4, 0, 0 },
+  { MUT_INI_STR, "Simd",       simd_cfg,      MUT_ARG_MAXLEN, 0, 0 },
+  { MUT_INI_STR, "Channels",   chan_cfg,      MUT_ARG_MAXLEN, 0, 0 },
+  { MUT_INI_STR, "WisdomFile", wisdom_file,   MUT_MAX_PATH_LEN, 0, 0 },
+  { MUT_INI_STR, "CostFile",   cost_file,     MUT_MAX_PATH_LEN, 0, 0 },
   { MUT_INI_END, NULL, NULL, 0, 0, 0 }
 };
 
@@ -247,7 +381,7 @@ setup
           set_y = 0,
           set_pps = 0,
           set_x = 0,
-          i;
+          i, ib0, ib1;
 
   if (*low_freq != 0)
     set_min = 1;
@@ -357,6 +491,63 @@ setup
     message("Bands per octave set to: %.3f", *bpo);
   }
 
+  // a frequency range keeps the bands of this layout that fall in it,
+  // the layout then starting at the first one kept
+
+  if ((mode == MODE_ANAL || mode == MODE_LIVE) &&
+      (freq_from > 0.0 || freq_to < HUGE_VAL))
+  {
+    if (logbase == 1.0)
+      ma = *bpo;
+    else
+      ma = *low_freq * pow(logbase, (*img_height - 1) / *bpo);
+
+    ib0 = 0;
+    ib1 = *img_height - 1;
+
+    if (logbase == 1.0)
+    {
+      if (freq_from > 0.0)
+        ib0 = (int32_t) ceil((freq_from / *wav_rate - *low_freq) /
+                             (ma - *low_freq) * ib1 - 1e-9);
+      if (freq_to < HUGE_VAL)
+        ib1 = (int32_t) floor((freq_to / *wav_rate - *low_freq) /
+                              (ma - *low_freq) * ib1 + 1e-9);
+    }
+    else
+    {
+      if (freq_from > 0.0)
+        ib0 = (int32_t) ceil(*bpo * (log_b(freq_from / *wav_rate) -
+                                     log_b(*low_freq)) - 1e-9);
+      if (freq_to < HUGE_VAL)
+        ib1 = (int32_t) floor(*bpo * (log_b(freq_to / *wav_rate) -
+                                      log_b(*low_freq)) + 1e-9);
+    }
+
+    if (ib0 < 0)
+      ib0 = 0;
+    if (ib1 > *img_height - 1)
+      ib1 = *img_height - 1;
+
+    if (ib1 - ib0 < 1)
+    {
+      message("%s", err_40);
+      exit(EXIT_FAILURE);
+    }
+
+    f = log_pos((double) ib0 / (*img_height - 1), *low_freq, ma);
+    if (logbase == 1.0)
+      *bpo = log_pos((double) ib1 / (*img_height - 1), *low_freq, ma);
+
+    message("Bands %d to %d of %d kept: %.3f to %.3f Hz", ib0, ib1,
+            *img_height, f * *wav_rate,
+            log_pos((double) ib1 / (*img_height - 1), *low_freq, ma) *
+            *wav_rate);
+
+    *low_freq = f;
+    *img_height = ib1 - ib0 + 1;
+  }
+
   if (set_x == 1 && mode == MODE_ANAL)
   {
     *pix_per_sec = (double) img_width * (double) *wav_rate / (double) samplecount;
@@ -366,7 +557,7 @@ setup
 
   if (
        (mode == MODE_ANAL && set_x == 0 && set_pps == 0) ||
-       (mode == MODE_SINE_SYNTH && set_pps == 0)
+       ((mode == MODE_SINE_SYNTH || mode == MODE_LIVE) && set_pps == 0)
      )
   {
     message("%s", err_24);
@@ -382,6 +573,7 @@ static int
 read_config_file(char *name)
 {
   char *str_p, *env, path[MUT_MAX_PATH_LEN];
+  char fname[MUT_MAX_NAME_LEN], ext[MUT_MAX_NAME_LEN];
   
   str_p = NULL;
 
@@ -414,7 +606,12 @@ read_config_file(char *name)
   }
   
   if (str_p == NULL)
+  {
+    strcpy(wisdom_file, def_wis);
+    strcpy(cost_file, def_cst);
+    strcpy(precision_file, def_prc);
     return 0;
+  }
 
   if (! mut_load_config(str_p, config))
   {
@@ -424,6 +621,203 @@ read_config_file(char *name)
     return -1;
   }
 
+  // unless specified otherwise the FFT wisdom and size costs are kept
+  // next to the config, and the precision reference always is
+
+  if (! mut_fname_split(str_p, path, fname, ext))
+    path[0] = 0;
+
+  if (wisdom_file[0] == 0)
+  {
+    strcpy(wisdom_file, path);
+    strcat(wisdom_file, def_wis);
+  }
+
+  if (cost_file[0] == 0)
+  {
+    strcpy(cost_file, path);
+    strcat(cost_file, def_cst);
+  }
+
+  strcpy(precision_file, path);
+  strcat(precision_file, def_prc);
+
+  return 1;
+}
+
+//======================================================================
+
+// reads a range given as from:to into 'from' and 'to', either of which
+// may be left out to keep its default. Returns 0 if it can't be read or
+// holds nothing.
+
+static int
+read_range(char *range, double *from, double *to)
+{
+  char part[MUT_ARG_MAXLEN], *colon;
+
+  colon = strchr(range, ':');
+  if (colon == NULL)
+    return 0;
+
+  strncpy(part, range, colon - range);
+  part[colon - range] = 0;
+
+  if (part[0] != 0 && ! mut_stof(part, from))
+    return 0;
+
+  if (colon[1] != 0 && ! mut_stof(colon + 1, to))
+    return 0;
+
+  return *from >= 0.0 && *from < *to;
+}
+
+//======================================================================
+
+// returns which options of the analysis given on the command line clash,
+// NULL if none do. The image is written one way: by -A (in blocks of -w),
+// -M, -t, -w or -z, or whole by default, which alone knows -8, -n and the
+// images of every channel (-C ms or all, -S); -w and -A only read the
+// first channel, -M, -t and -z the first one, the mix or the mid signal
+
+static char *
+option_clash(void)
+{
+  static char clash[64];
+  char *way[5];
+  int32_t n, multi_chan;
+
+  multi_chan = chan_mode == CHAN_MS || chan_mode == CHAN_ALL;
+
+  n = 0;
+  if (append)
+    way[n++] = "-A";
+  if (mipmap >= 0)
+    way[n++] = "-M";
+  if (time_range_s[0] != 0)
+    way[n++] = "-t";
+  if (block_len_s[0] != 0 && ! append)
+    way[n++] = "-w";
+  if (row_pipe)
+    way[n++] = "-z";
+
+  if (n > 1)
+    sprintf(clash, "%s with %s", way[0], way[1]);
+  else if (direct_u8 && n > 0)
+    sprintf(clash, "-8 with %s", way[0]);
+  else if (direct_u8 && multi_chan)
+    sprintf(clash, "-8 with -C %s", chan_names[chan_mode]);
+  else if (seg_len_s[0] != 0 && n > 0)
+    sprintf(clash, "-n with %s", way[0]);
+  else if (stack_chan && n > 0)
+    sprintf(clash, "-S with %s", way[0]);
+  else if (stack_chan && ! multi_chan)
+    sprintf(clash, "-S without -C ms or all");
+  else if (chan_given && chan_mode != CHAN_FIRST &&
+           (append || block_len_s[0] != 0))
+    sprintf(clash, "-C %s with %s", chan_names[chan_mode], way[0]);
+  else if (chan_given && chan_mode == CHAN_ALL && n > 0)
+    sprintf(clash, "-C all with %s", way[0]);
+  else
+    return NULL;
+
+  return clash;
+}
+
+//======================================================================
+
+// prepares the channels of sound for the analysis as chan_mode says and
+// returns the number of signals to analyse, 0 if it can't be done
+
+static int32_t
+select_channels(real **sound, int32_t channels, int32_t samplecount)
+{
+  if (chan_mode == CHAN_MIX)
+  {
+    downmix(sound, channels, samplecount);
+    return 1;
+  }
+
+  if (chan_mode == CHAN_MS)
+  {
+    if (channels != 2)
+    {
+      message("%s", err_34);
+      return 0;
+    }
+
+    mid_side(sound, samplecount);
+    return 2;
+  }
+
+  if (chan_mode == CHAN_ALL)
+    return channels;
+
+  return 1;
+}
+
+//======================================================================
+
+// returns 1 if an image of x by y pixels can be written as a BMP file,
+// says so and returns 0 otherwise
+
+static int
+bmp_size_ok(int32_t y, int32_t x)
+{
+  if (bmp_fits(y, x))
+    return 1;
+
+  message("%s (%d x %d)", err_42, x, y);
+  return 0;
+}
+
+//======================================================================
+
+// creates the image file of signal ic of a multichannel analysis, named
+// after the output file: name_1.bmp, name_2.bmp ... or name_mid.bmp and
+// name_side.bmp
+
+static FILE *
+create_channel_file(int32_t ic)
+{
+  char path[MUT_MAX_PATH_LEN], fname[MUT_MAX_PATH_LEN];
+  char name[MUT_MAX_NAME_LEN], ext[MUT_MAX_NAME_LEN], suffix[16];
+
+  if (! mut_fname_split(output_file, path, name, ext))
+    return NULL;
+
+  if (chan_mode == CHAN_MS)
+    strcpy(suffix, ic ? "_side" : "_mid");
+  else
+    sprintf(suffix, "_%d", ic + 1);
+
+  strcpy(fname, path);
+  strcat(fname, name);
+  strcat(fname, suffix);
+  strcat(fname, ext);
+
+  message("Channel %d to '%s'", ic + 1, fname);
+
+  return fopen(fname, "wb");
+}
+
+//======================================================================
+
+// makes the name of the tile files (-M) in base: the output file's,
+// without its extension, so that 'name.bmp' gives name.tiles & name.idx
+
+static int32_t
+tile_base_name(char *base)
+{
+  char path[MUT_MAX_PATH_LEN];
+  char name[MUT_MAX_NAME_LEN], ext[MUT_MAX_NAME_LEN];
+
+  if (! mut_fname_split(output_file, path, name, ext))
+    return 0;
+
+  strcpy(base, path);
+  strcat(base, name);
+
   return 1;
 }
 
@@ -432,10 +826,16 @@ read_config_file(char *name)
 int
 main(int argc, char *argv[])
 {
-  double **sound, **image;
+  real **sound;
+  image_t *image, **images;
+  quant_t q;
+  double max, *maxes;
+  int32_t nsig, multi, x0, x1, a, b;
   int i;
 
   char path[MUT_MAX_PATH_LEN], name[MUT_MAX_NAME_LEN], ext[MUT_MAX_NAME_LEN];
+  char tile_base[MUT_MAX_PATH_LEN];
+  char *clash;
 
   //=============================
   // parse command line arguments
@@ -464,6 +864,13 @@ main(int argc, char *argv[])
     return 1;
   }
 
+  // the columns of a live analysis go to the standard output unless
+  // told otherwise, which then carries nothing else
+
+  if (strcmp(prog_mode_s, "live") == 0 &&
+      (output_file[0] == 0 || strcmp(output_file, "-") == 0))
+    quiet = 1;
+
   //===============
   // set up logging
   //===============
@@ -502,12 +909,155 @@ main(int argc, char *argv[])
     prog_mode = MODE_SINE_SYNTH;
   else if (strcmp(prog_mode_s, "noise") == 0)
     prog_mode = MODE_NOISE_SYNTH;
+  else if (strcmp(prog_mode_s, "bench") == 0)
+    prog_mode = MODE_BENCH;
+  else if (strcmp(prog_mode_s, "live") == 0)
+    prog_mode = MODE_LIVE;
   else
   {
     message("%s (%s)", err_3, prog_mode_s);
     return 1;
   }
 
+  //======= FFT planning effort =======
+
+  if (fft_plan_s[0] == 0)
+    strcpy(fft_plan_s, fft_plan_cfg);
+
+  if (fft_plan_s[0] == 0 || strcmp(fft_plan_s, "estimate") == 0)
+    fft_effort = FFT_ESTIMATE;
+  else if (strcmp(fft_plan_s, "measure") == 0)
+    fft_effort = FFT_MEASURE;
+  else if (strcmp(fft_plan_s, "patient") == 0)
+    fft_effort = FFT_PATIENT;
+  else
+  {
+    message("%s (%s)", err_25, fft_plan_s);
+    return 1;
+  }
+
+  //======= FFT backend =======
+
+  if (fft_backend_s[0] != 0)
+  {
+    fft_backend = fft_find_backend(fft_backend_s);
+    if (fft_backend < 0)
+    {
+      message("%s (%s)", err_29, fft_backend_s);
+      return 1;
+    }
+  }
+  else if (fft_backend_cfg[0] != 0)
+  {
+    // the shipped config names FFTW, which a build without it lacks:
+    // such a build runs with its own default rather than not at all
+    fft_backend = fft_find_backend(fft_backend_cfg);
+    if (fft_backend < 0)
+    {
+      message("Warning: FFT backend '%s' of the config file is not in "
+              "this build, using the default one.", fft_backend_cfg);
+      fft_backend = 0;
+    }
+  }
+
+  //======= channels to analyse =======
+
+  chan_given = chan_mode_s[0] != 0;
+  if (chan_mode_s[0] == 0)
+    strcpy(chan_mode_s, chan_cfg);
+
+  if (chan_mode_s[0] == 0 || strcmp(chan_mode_s, "first") == 0)
+    chan_mode = CHAN_FIRST;
+  else if (strcmp(chan_mode_s, "mix") == 0)
+    chan_mode = CHAN_MIX;
+  else if (strcmp(chan_mode_s, "ms") == 0)
+    chan_mode = CHAN_MS;
+  else if (strcmp(chan_mode_s, "all") == 0)
+    chan_mode = CHAN_ALL;
+  else
+  {
+    message("%s (%s)", err_33, chan_mode_s);
+    return 1;
+  }
+
+  //======= tile pyramid =======
+
+  if (mipmap_s[0] == 0)
+    mipmap = -1;
+  else if (strcmp(mipmap_s, "max") == 0)
+    mipmap = POOL_MAX;
+  else if (strcmp(mipmap_s, "mean") == 0)
+    mipmap = POOL_MEAN;
+  else
+  {
+    message("%s (%s)", err_41, mipmap_s);
+    return 1;
+  }
+
+  //======= FFT threads =======
+
+  if (threads_s[0] != 0)
+  {
+    if (! mut_stoi(threads_s, MUT_BASE_DEC, &threads))
+    {
+      message("%s '%s'", err_7, threads_s);
+      return 1;
+    }
+  }
+
+  if (threads < 0 || threads > MAX_THREADS)
+  {
+    message("%s", err_26);
+    return 1;
+  }
+
+  if (threads == 0)
+    threads = cpu_count();
+
+  //======= SIMD level of the DSP kernels =======
+
+  if (simd_s[0] == 0)
+    strcpy(simd_s, simd_cfg);
+
+  if (simd_s[0] != 0)
+  {
+    for (simd_level = KERN_AUTO; simd_level <= KERN_AVX512; simd_level++)
+      if (strcmp(simd_s, kernels_name(simd_level)) == 0)
+        break;
+
+    if (simd_level > KERN_AVX512)
+    {
+      message("%s (%s)", err_27, simd_s);
+      return 1;
+    }
+  }
+
+  if (! kernels_init(simd_level))
+  {
+    message("%s (%s)", err_28, simd_s);
+    return 1;
+  }
+
+  //======= frequency scale =======
+
+  if (use_linear)
+    logbase = 1;
+  else
+    logbase = 2;
+
+  //======= FFT benchmark (needs no files) =======
+
+  if (prog_mode == MODE_BENCH)
+  {
+    fft_init(wisdom_file, cost_file, fft_effort, threads, fft_backend);
+    bank_init();
+    fft_bench();
+    precision_check(precision_file);
+    bank_cleanup();
+    fft_cleanup();
+    return 0;
+  }
+
   //======= file names =======
 
   if (input_file[0] == 0)
@@ -516,7 +1066,8 @@ main(int argc, char *argv[])
     return 1;
   }
       
-  if (! mut_fname_split(input_file, path, name, ext))
+  if (prog_mode != MODE_LIVE &&
+      ! mut_fname_split(input_file, path, name, ext))
   {
      message("%s", err_16);
      return 1;
@@ -530,7 +1081,7 @@ main(int argc, char *argv[])
        return 1;
      }
   }
-  else
+  else if (prog_mode != MODE_LIVE)		// a live stream has any name
   {
      if (strcmp(ext, ".bmp") != 0)
      {
@@ -539,7 +1090,9 @@ main(int argc, char *argv[])
      }
   }
   
-  if (output_file[0] == 0) 
+  if (output_file[0] == 0 && prog_mode == MODE_LIVE)
+    strcpy(output_file, "-");
+  else if (output_file[0] == 0) 
   {
     strcpy(output_file, path);
     strcat(output_file, name);
@@ -658,6 +1211,73 @@ main(int argc, char *argv[])
     return 1;
   }
 
+  //======= analysis segments =======
+
+  if (seg_len_s[0] != 0)
+  {
+    if (! mut_stof(seg_len_s, &seg_len))
+    {
+      message("%s '%s'", err_7, seg_len_s);
+      return 1;
+    }
+  }
+
+  if (seg_len < 0.0 || seg_len > MAX_SEG_LEN)
+  {
+    message("%s", err_30);
+    return 1;
+  }
+
+  //======= streaming blocks =======
+
+  if (block_len_s[0] != 0)
+  {
+    if (! mut_stof(block_len_s, &block_len))
+    {
+      message("%s '%s'", err_7, block_len_s);
+      return 1;
+    }
+  }
+
+  if (block_len < 0.0 || block_len > MAX_BLOCK_LEN)
+  {
+    message("%s", err_31);
+    return 1;
+  }
+
+  //======= live latency =======
+
+  if (latency_s[0] != 0)
+  {
+    if (! mut_stof(latency_s, &latency))
+    {
+      message("%s '%s'", err_7, latency_s);
+      return 1;
+    }
+  }
+
+  if (latency < 0.0 || latency > MAX_LATENCY)
+  {
+    message("%s", err_35);
+    return 1;
+  }
+
+  //======= analysis region =======
+
+  if (time_range_s[0] != 0 &&
+      ! read_range(time_range_s, &time_from, &time_to))
+  {
+    message("%s (%s)", err_38, time_range_s);
+    return 1;
+  }
+
+  if (freq_range_s[0] != 0 &&
+      ! read_range(freq_range_s, &freq_from, &freq_to))
+  {
+    message("%s (%s)", err_38, freq_range_s);
+    return 1;
+  }
+
   //======= image dimensions =======
 
   if (img_width_s[0] != 0)
@@ -678,30 +1298,70 @@ main(int argc, char *argv[])
     }
   }
 
-  //======= miscellaneous parameters =======
+  //======= options that clash =======
 
-  if (use_linear)
-    logbase = 1;
-  else
-    logbase = 2;
+  clash = prog_mode == MODE_ANAL ? option_clash() : NULL;
+  if (clash != NULL)
+  {
+    message("%s (%s)", err_43, clash);
+    return 1;
+  }
+
+  // the block length of the config file is for the runs that stream,
+  // it gives way to any option that -w can't honour
+  if (prog_mode == MODE_ANAL && block_len_s[0] == 0 && ! append &&
+      (mipmap >= 0 || time_range_s[0] != 0 || row_pipe || direct_u8 ||
+       seg_len_s[0] != 0 || stack_chan ||
+       (chan_given && chan_mode != CHAN_FIRST)))
+    block_len = 0.0;
 
   //====================
   // open & create files
   //====================
 
-  infile = fopen(input_file, "rb");
+  if (prog_mode == MODE_LIVE && strcmp(input_file, "-") == 0)
+  {
+#ifdef _WIN32
+    _setmode(_fileno(stdin), _O_BINARY);
+#endif
+    infile = stdin;
+  }
+  else
+    infile = fopen(input_file, "rb");
+
   if (infile == NULL)
   {
     message("%s", err_14);
     return 1;
   }
 
-  outfile = fopen(output_file, "wb");
-  if (outfile == NULL)
+  // every channel of a multichannel analysis gets its own file, unless
+  // they are stacked, or only the first one is analysed (-w, -z, -t)
+
+  multi = prog_mode == MODE_ANAL && block_len == 0.0 && ! row_pipe &&
+          ! append && time_range_s[0] == 0 && mipmap < 0 &&
+          (chan_mode == CHAN_MS || chan_mode == CHAN_ALL);
+
+  // an image to extend is opened by anal_append(), which knows whether
+  // it can be kept, a pyramid of tiles replaces the image
+
+  if (prog_mode == MODE_LIVE && strcmp(output_file, "-") == 0)
   {
-    fclose(infile);
-    message("%s", err_15);
-    return 1;
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+    outfile = stdout;
+  }
+  else if ((! multi || stack_chan) &&
+           ! (prog_mode == MODE_ANAL && (append || mipmap >= 0)))
+  {
+    outfile = fopen(output_file, "wb");
+    if (outfile == NULL)
+    {
+      fclose(infile);
+      message("%s", err_15);
+      return 1;
+    }
   }
 
   //===================================
@@ -709,11 +1369,47 @@ main(int argc, char *argv[])
   //===================================
 
   srand(time(NULL));
+  fft_init(wisdom_file, cost_file, fft_effort, threads, fft_backend);
+  bank_init();
 
-  if (prog_mode == MODE_ANAL)
+  if (prog_mode == MODE_ANAL && append)
   {
     message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    bits = wav_open(infile, &channels, &samplecount, &wav_rate);
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
+
+    if (! bmp_size_ok(img_height, anal_width(samplecount, pix_per_sec)))
+      return 1;
+
+    start_time = gettime();
+    if (! anal_append
+          (
+            infile, output_file, channels, samplecount, bits, wav_rate,
+            img_height, band_per_oct, pix_per_sec, low_freq,
+            block_len > 0.0 ? block_len : DEF_APPEND_BLOCK, gamma_corr
+          ))
+    {
+      message("%s", err_15);
+      return 1;
+    }
+  }
+  else if (prog_mode == MODE_ANAL && mipmap >= 0)
+  {
+    if (! tile_base_name(tile_base))
+    {
+      message("%s", err_15);
+      return 1;
+    }
+
+    message("Sound '%s' to tiles '%s.tiles'", input_file, tile_base);
     sound = wav_in(infile, &channels, &samplecount, &wav_rate);
+    if (select_channels(sound, channels, samplecount) == 0)
+      return 1;
+
     setup
     (
       &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
@@ -721,23 +1417,259 @@ main(int argc, char *argv[])
     );
 
     start_time = gettime();
-    image = anal
+    if (! anal_tiles
+          (
+            sound[0], samplecount, wav_rate, tile_base, img_height,
+            band_per_oct, pix_per_sec, low_freq, gamma_corr, mipmap
+          ))
+    {
+      message("%s", err_15);
+      return 1;
+    }
+  }
+  else if (prog_mode == MODE_ANAL && time_range_s[0] != 0)
+  {
+    message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    bits = wav_open(infile, &channels, &samplecount, &wav_rate);
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
+
+    // the columns of the range, and only the samples they need
+
+    x0 = (int32_t) floor(time_from * wav_rate * pix_per_sec);
+    x1 = anal_width(samplecount, pix_per_sec);
+    if (time_to * wav_rate < samplecount)
+      x1 = (int32_t) ceil(time_to * wav_rate * pix_per_sec);
+
+    if (x0 >= x1)
+    {
+      message("%s", err_39);
+      return 1;
+    }
+
+    if (! bmp_size_ok(img_height, x1 - x0))
+      return 1;
+
+    anal_span(x0, x1, anal_margin(img_height, band_per_oct, pix_per_sec,
+                                  low_freq),
+              samplecount, pix_per_sec, &a, &b);
+
+    sound = malloc(channels * sizeof(real *));
+    for (i = 0; i < channels; i++)
+      sound[i] = buf_alloc(b - a);
+
+    wav_seek(infile, a, channels, bits);
+    wav_read(infile, sound, b - a, channels, bits);
+    fclose(infile);
+
+    if (select_channels(sound, channels, b - a) == 0)
+      return 1;
+
+    message("Columns %d to %d, samples %d to %d", x0, x1 - 1, a, b - 1);
+
+    start_time = gettime();
+    image = anal_region
             (
-              sound[0], samplecount, wav_rate,
-              &img_width, img_height, band_per_oct, pix_per_sec, low_freq
+              sound[0], a, samplecount, x0, x1, img_height, band_per_oct,
+              pix_per_sec, low_freq, &max
             );
 
-    if (gamma_corr != 1.0)
-      brightness_control(image, img_height, img_width, 1.0 / gamma_corr);
+    quant_init(&q, max, 1.0 / gamma_corr);
+    bmp_out(outfile, image, &q);
+    image_free(image);
+  }
+  else if (prog_mode == MODE_ANAL && block_len > 0.0)
+  {
+    message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    bits = wav_open(infile, &channels, &samplecount, &wav_rate);
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
+
+    if (! bmp_size_ok(img_height, anal_width(samplecount, pix_per_sec)))
+      return 1;
+
+    start_time = gettime();
+    if (! anal_stream
+          (
+            infile, outfile, channels, samplecount, bits, wav_rate,
+            img_height, band_per_oct, pix_per_sec, low_freq, block_len,
+            gamma_corr
+          ))
+    {
+      message("%s", err_32);
+      return 1;
+    }
+
+    fclose(outfile);
+  }
+  else if (prog_mode == MODE_ANAL && row_pipe)
+  {
+    message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    sound = wav_in(infile, &channels, &samplecount, &wav_rate);
+    if (select_channels(sound, channels, samplecount) == 0)
+      return 1;
+
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
+
+    if (! bmp_size_ok(img_height, anal_width(samplecount, pix_per_sec)))
+      return 1;
+
+    start_time = gettime();
+    if (! anal_pipe
+          (
+            sound[0], samplecount, outfile, img_height, band_per_oct,
+            pix_per_sec, low_freq, gamma_corr
+          ))
+    {
+      message("%s", err_32);
+      return 1;
+    }
+
+    fclose(outfile);
+  }
+  else if (prog_mode == MODE_ANAL && multi)
+  {
+    message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    sound = wav_in(infile, &channels, &samplecount, &wav_rate);
+    nsig = select_channels(sound, channels, samplecount);
+    if (nsig == 0)
+      return 1;
+
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
 
-    bmp_out(outfile, image, img_height, img_width);
+    if (! bmp_size_ok(stack_chan ? nsig * img_height : img_height,
+                      anal_width(samplecount, pix_per_sec)))
+      return 1;
+
+    start_time = gettime();
+    maxes = malloc(nsig * sizeof(double));
+    images = anal_channels
+             (
+               sound, nsig, samplecount, wav_rate, img_height,
+               band_per_oct, pix_per_sec, low_freq, stack_chan, maxes
+             );
+
+    // a stacked image is normalised as a whole, the others on their own
+
+    for (i = 0, max = 0.0; i < nsig; i++)
+      if (maxes[i] > max)
+        max = maxes[i];
+
+    for (i = 0; i < nsig; i++)
+    {
+      if (images[i] == NULL)
+        continue;
+
+      if (! stack_chan)
+      {
+        outfile = create_channel_file(i);
+        if (outfile == NULL)
+        {
+          message("%s", err_15);
+          return 1;
+        }
+
+        max = maxes[i];
+      }
+
+      quant_init(&q, max, 1.0 / gamma_corr);
+      bmp_out(outfile, images[i], &q);
+      image_free(images[i]);
+    }
+
+    free(images);
+    free(maxes);
+  }
+  else if (prog_mode == MODE_ANAL)
+  {
+    message("Sound '%s' to spectrogram '%s'", input_file, output_file);
+    sound = wav_in(infile, &channels, &samplecount, &wav_rate);
+    if (select_channels(sound, channels, samplecount) == 0)
+      return 1;
+
+    setup
+    (
+      &img_height, samplecount, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, img_width, 0
+    );
+
+    if (! bmp_size_ok(img_height, anal_width(samplecount, pix_per_sec)))
+      return 1;
+
+    start_time = gettime();
+    if (direct_u8)
+      image = anal_u8
+              (
+                sound[0], samplecount, wav_rate, img_height, band_per_oct,
+                pix_per_sec, low_freq, 1.0 / gamma_corr
+              );
+    else
+    {
+      image = anal
+              (
+                sound[0], samplecount, wav_rate,
+                img_height, band_per_oct, pix_per_sec, low_freq, &max
+              );
+
+      quant_init(&q, max, 1.0 / gamma_corr);
+    }
+
+    bmp_out(outfile, image, &q);
+    image_free(image);
+  }
+  else if (prog_mode == MODE_LIVE)
+  {
+    message("Live sound '%s' to columns '%s'", input_file, output_file);
+    if (chan_mode == CHAN_MS || chan_mode == CHAN_ALL)
+    {
+      message("%s", err_37);
+      return 1;
+    }
+
+    bits = wav_open(infile, &channels, &samplecount, &wav_rate);
+    setup
+    (
+      &img_height, 0, &wav_rate, &low_freq, &high_freq,
+      &pix_per_sec, &band_per_oct, 0, MODE_LIVE
+    );
+
+    start_time = gettime();
+    if (! anal_live
+          (
+            infile, outfile, channels, bits, wav_rate, img_height,
+            band_per_oct, pix_per_sec, low_freq, latency * wav_rate,
+            gamma_corr, chan_mode == CHAN_MIX
+          ))
+    {
+      message("%s", err_36);
+      return 1;
+    }
+
+    if (outfile != stdout)
+      fclose(outfile);
   }
 
   if (prog_mode == MODE_SINE_SYNTH || prog_mode == MODE_NOISE_SYNTH)
   {
     message("Image '%s' to sound '%s'", input_file, output_file);
-    sound = calloc(1, sizeof(double *));
-    image = bmp_in(infile, &img_height, &img_width);
+    sound = calloc(1, sizeof(real *));
+    image = bmp_in(infile);
+    img_height = image->height;
+    img_width = image->width;
 
     setup
     (
@@ -746,21 +1678,21 @@ main(int argc, char *argv[])
     );
 
     if (gamma_corr != 1.0)
-      brightness_control(image, img_height, img_width, gamma_corr);
+      brightness_control(image, gamma_corr);
 
     start_time = gettime();
 
     if (prog_mode == MODE_SINE_SYNTH)
       sound[0] = synt_sine
                  (
-                   image, img_width, img_height, &samplecount, wav_rate,
-                   low_freq, pix_per_sec, band_per_oct
+                   image, &samplecount, wav_rate, low_freq, pix_per_sec,
+                   band_per_oct
                  );
     else
       sound[0] = synt_noise
                  (
-                   image, img_width, img_height, &samplecount, wav_rate,
-                   low_freq, pix_per_sec, band_per_oct
+                   image, &samplecount, wav_rate, low_freq, pix_per_sec,
+                   band_per_oct
                  );
 
     wav_out(outfile, sound, 1, samplecount, wav_rate, WAV_FORMAT);
@@ -769,5 +1701,8 @@ main(int argc, char *argv[])
   end_time = gettime();
   message("Processing time: %.3f s", (double) (end_time - start_time) / 1000.0);
 
+  bank_cleanup();
+  fft_cleanup();
+
   return 0;
 }
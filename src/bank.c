@@ -0,0 +1,290 @@
+/*
+  bank.c - filter bank of the analysis & the noise synthesis
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "pool.h"
+#include "image.h"
+#include "dsp.h"
+#include "bank.h"
+
+#define BANK_CACHE		16	// most banks kept for later use
+#define BANK_MAX_WEIGHTS	(1 << 22)	// most weights held by a bank,
+						// wider banks compute them
+						// band by band when asked
+
+#define PI			3.1415926535897932
+
+extern double logbase;
+
+// The banks are kept until bank_cleanup() or until they are the least
+// recently used of the unused ones when a new one is needed, so the
+// segments of an analysis, which mostly have the same length, and the
+// files of a job share them.
+
+static bank_t *cache[BANK_CACHE];
+static uint32_t clock_now = 0;		// the age of the cache entries
+static mutex_t bank_lock;
+
+//=====================================================================
+
+void
+bank_init(void)
+{
+  mutex_init(&bank_lock);
+}
+
+//=====================================================================
+
+static void
+bank_free(bank_t *b)
+{
+  free(b->Fa);
+  free(b->Fd);
+  free(b->off);
+  free(b->La);
+  free(b->Ld);
+  buf_free(b->w);
+  free(b);
+}
+
+//=====================================================================
+
+void
+bank_cleanup(void)
+{
+  int32_t i;
+
+  for (i = 0; i < BANK_CACHE; i++)
+    if (cache[i] != NULL)
+    {
+      bank_free(cache[i]);
+      cache[i] = NULL;
+    }
+
+  mutex_destroy(&bank_lock);
+}
+
+//=====================================================================
+
+// computes the Hann weights of band ib into w
+
+static void
+band_weights(bank_t *b, int32_t ib, real *w)
+{
+  int32_t i;
+  double Li;
+
+  for (i = b->Fa[ib]; i < b->Fd[ib]; i++)
+  {
+    Li = log_pos_inv((double) i / (double) b->size, b->basefreq, b->maxfreq);	// calculation of the logarithmic position
+    Li = (Li - b->La[ib]) / (b->Ld[ib] - b->La[ib]);
+    w[i - b->Fa[ib]] = 0.5 - 0.5 * cos(2.0 * PI * Li);	// Hann function
+  }
+}
+
+//=====================================================================
+
+static void
+weights_task(void *ctx, int32_t task, int32_t worker)
+{
+  bank_t *b = (bank_t *) ctx;
+
+  band_weights(b, task, &b->w[b->off[task]]);
+}
+
+//=====================================================================
+
+// builds the bank of 'bands' bands for transforms of 'size' points, the
+// weights with nthreads threads
+
+static bank_t *
+bank_build
+(
+  int32_t size, int32_t bands, double basefreq, double maxfreq,
+  int32_t nthreads
+)
+{
+  int32_t ib, Fa, Fd;
+  bank_t *b;
+  double *cost;
+
+  b = malloc(sizeof(bank_t));
+  b->size = size;
+  b->bands = bands;
+  b->basefreq = basefreq;
+  b->maxfreq = maxfreq;
+  b->logbase = logbase;
+  b->users = 0;
+
+  b->Fa = malloc(bands * sizeof(int32_t));
+  b->Fd = malloc(bands * sizeof(int32_t));
+  b->off = malloc((bands + 1) * sizeof(int32_t));
+  b->La = malloc(bands * sizeof(double));
+  b->Ld = malloc(bands * sizeof(double));
+  b->wmax = 0;
+
+  for (ib = 0; ib < bands; ib++)
+  {
+    Fa =
+      roundoff(log_pos((double) (ib - 1) / (double) (bands - 1), basefreq, maxfreq) * size);
+    Fd =
+      roundoff(log_pos((double) (ib + 1) / (double) (bands - 1), basefreq, maxfreq) * size);
+
+    // the Hann window spans Fa .. Fd, but the bins used stop at the
+    // Nyquist frequency and don't include the DC
+    b->La[ib] = log_pos_inv((double) Fa / (double) size, basefreq, maxfreq);
+    b->Ld[ib] = log_pos_inv((double) Fd / (double) size, basefreq, maxfreq);
+
+    if (Fd > size / 2)
+      Fd = size / 2;
+
+    if (Fa < 1)
+      Fa = 1;
+
+    if (Fd < Fa)
+      Fd = Fa;
+
+    b->Fa[ib] = Fa;
+    b->Fd[ib] = Fd;
+
+    b->off[ib] = ib ? b->off[ib - 1] + b->Fd[ib - 1] - b->Fa[ib - 1] : 0;
+    if (b->Fd[ib] - b->Fa[ib] > b->wmax)
+      b->wmax = b->Fd[ib] - b->Fa[ib];
+  }
+
+  b->off[bands] = b->off[bands - 1] + b->Fd[bands - 1] - b->Fa[bands - 1];
+
+  if (b->off[bands] > BANK_MAX_WEIGHTS)
+  {
+    b->w = NULL;
+    return b;
+  }
+
+  b->w = buf_alloc(b->off[bands] + 1);
+
+  cost = malloc(bands * sizeof(double));
+  for (ib = 0; ib < bands; ib++)
+    cost[ib] = b->Fd[ib] - b->Fa[ib];
+
+  pool_run(bands, cost, weights_task, b, nthreads);
+
+  free(cost);
+
+  return b;
+}
+
+//=====================================================================
+
+// returns the bank of 'bands' bands between basefreq and maxfreq for
+// transforms of 'size' points, building it with nthreads threads if it
+// isn't cached. It must be given back with bank_release().
+
+bank_t *
+bank_get
+(
+  int32_t size, int32_t bands, double basefreq, double maxfreq,
+  int32_t nthreads
+)
+{
+  int32_t i, slot;
+  bank_t *b;
+
+  mutex_lock(&bank_lock);
+
+  clock_now++;
+
+  for (i = 0; i < BANK_CACHE; i++)
+  {
+    b = cache[i];
+
+    if (b != NULL && b->size == size && b->bands == bands &&
+        b->basefreq == basefreq && b->maxfreq == maxfreq &&
+        b->logbase == logbase)
+    {
+      b->users++;
+      b->last = clock_now;
+      mutex_unlock(&bank_lock);
+
+      return b;
+    }
+  }
+
+  // a free slot, or else the one of the oldest unused bank
+
+  slot = -1;
+  for (i = 0; i < BANK_CACHE && (slot < 0 || cache[slot] != NULL); i++)
+    if (cache[i] == NULL || (cache[i]->users == 0 &&
+                             (slot < 0 || cache[i]->last < cache[slot]->last)))
+      slot = i;
+
+  b = bank_build(size, bands, basefreq, maxfreq, nthreads);
+  b->users = 1;
+  b->last = clock_now;
+
+  if (slot >= 0)			// else it's freed once released
+  {
+    if (cache[slot] != NULL)
+      bank_free(cache[slot]);
+
+    cache[slot] = b;
+  }
+
+  mutex_unlock(&bank_lock);
+
+  return b;
+}
+
+//=====================================================================
+
+void
+bank_release(bank_t *b)
+{
+  int32_t i, cached;
+
+  mutex_lock(&bank_lock);
+
+  b->users--;
+
+  for (i = cached = 0; i < BANK_CACHE; i++)
+    if (cache[i] == b)
+      cached = 1;
+
+  if (b->users == 0 && ! cached)
+    bank_free(b);
+
+  mutex_unlock(&bank_lock);
+}
+
+//=====================================================================
+
+// returns the weights of band ib, the Hann window sampled at the bins
+// Fa[ib] .. Fd[ib] - 1, computed into buf (wmax long) if the bank is too
+// wide to hold them
+
+real *
+bank_weights(bank_t *b, int32_t ib, real *buf)
+{
+  if (b->w != NULL)
+    return &b->w[b->off[ib]];
+
+  band_weights(b, ib, buf);
+
+  return buf;
+}
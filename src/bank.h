@@ -0,0 +1,44 @@
+/*
+  bank.h - definitions of the filter bank functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_BANK
+#define H_BANK
+
+// The bands of the analysis and of the noise synthesis are Hann windows
+// over the bins of a transform, which only depend on its size and on the
+// frequency scale, so they are computed once for every configuration.
+// Band ib is applied to the bins Fa[ib] + 1 .. Fd[ib] of the spectrum
+// with the weights w[off[ib]] .. (Fd[ib] - Fa[ib] of them).
+
+typedef struct
+{
+  int32_t size, bands;		// the configuration it was built for
+  double basefreq, maxfreq, logbase;
+  int32_t *Fa, *Fd;		// the bins of every band
+  double *La, *Ld;		// the log positions of the window edges
+  int32_t *off;			// where the weights of every band start
+  int32_t wmax;			// the most weights of a band
+  real *w;			// the weights, NULL if computed on demand
+  int32_t users;		// bank_get() calls not yet released
+  uint32_t last;		// when it was last asked for
+} bank_t;
+
+extern void bank_init(void);
+extern void bank_cleanup(void);
+extern bank_t *bank_get(int32_t size, int32_t bands, double basefreq,
+			double maxfreq, int32_t nthreads);
+extern void bank_release(bank_t *b);
+extern real *bank_weights(bank_t *b, int32_t ib, real *buf);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+  buffer.c - aligned & padded sample buffers
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "util.h"
+#include "buffer.h"
+
+#define BUF_STEP		(BUF_ALIGN / sizeof(real))	// samples per
+								// aligned block
+
+// Every buffer starts on a BUF_ALIGN boundary and its capacity is rounded
+// up to a whole number of aligned blocks, so that vector loops may run past
+// the last sample without checking for the tail. The header just before
+// the first sample keeps the block returned by malloc() and the capacity.
+
+typedef struct
+{
+  void *block;			// what malloc() returned
+  int32_t capacity;		// number of samples that fit in the buffer
+} buf_header_t;
+
+//=====================================================================
+
+static buf_header_t *
+header_of(real *p)
+{
+  return (buf_header_t *) ((char *) p - sizeof(buf_header_t));
+}
+
+//=====================================================================
+
+// allocates an uninitialised buffer of n samples, the padding after the
+// last sample is cleared
+
+real *
+buf_alloc(int32_t n)
+{
+  int32_t capacity;
+  char *block;
+  real *p;
+
+  if (n < 1)
+    n = 1;
+
+  capacity = (n + BUF_STEP - 1) / BUF_STEP * BUF_STEP;
+
+  block = malloc(capacity * sizeof(real) + sizeof(buf_header_t) + BUF_ALIGN);
+  if (block == NULL)
+  {
+    message("Out of memory (%d samples).", n);
+    exit(1);
+  }
+
+  p = (real *) (((uintptr_t) (block + sizeof(buf_header_t)) + BUF_ALIGN - 1) &
+                ~(uintptr_t) (BUF_ALIGN - 1));
+
+  header_of(p)->block = block;
+  header_of(p)->capacity = capacity;
+
+  memset(&p[n], 0, (capacity - n) * sizeof(real));
+
+  return p;
+}
+
+//=====================================================================
+
+// allocates a buffer of n samples set to zero
+
+real *
+buf_calloc(int32_t n)
+{
+  real *p;
+
+  p = buf_alloc(n);
+  memset(p, 0, header_of(p)->capacity * sizeof(real));
+
+  return p;
+}
+
+//=====================================================================
+
+// changes the length of a buffer to n samples, keeping its content like
+// realloc(). The buffer stays in place whenever it is large enough.
+
+real *
+buf_resize(real *p, int32_t n)
+{
+  real *q;
+  int32_t old;
+
+  if (p == NULL)
+    return buf_alloc(n);
+
+  old = header_of(p)->capacity;
+  if (n <= old)
+    return p;
+
+  q = buf_alloc(n);
+  memcpy(q, p, old * sizeof(real));
+  buf_free(p);
+
+  return q;
+}
+
+//=====================================================================
+
+void
+buf_free(real *p)
+{
+  if (p != NULL)
+    free(header_of(p)->block);
+}
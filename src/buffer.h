@@ -0,0 +1,26 @@
+/*
+  buffer.h - prototypes of the aligned buffer functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_BUFFER
+#define H_BUFFER
+
+#define BUF_ALIGN		64	// alignment of the buffers in bytes, enough
+					// for the widest SIMD registers (AVX-512)
+
+extern real *buf_alloc(int32_t n);
+extern real *buf_calloc(int32_t n);
+extern real *buf_resize(real *p, int32_t n);
+extern void buf_free(real *p);
+
+#endif
@@ -16,56 +16,75 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <math.h>
-#include <fftw3.h>
 #include <float.h>
 #include <time.h>
 #include <string.h>
 
 #include "util.h"
+#include "buffer.h"
+#include "fft.h"
+#include "kernels.h"
+#include "pool.h"
+#include "bank.h"
+#include "image.h"
+#include "resample.h"
 #include "dsp.h"
 
-#define BMSQ_LUT_SIZE		16000
 #define BANK_LOOP_SIZE		10.0
 #define TRANSITION_BW_SYNT	16.0	// defines the transition bandwidth
 					// for the low-pass filter on the
 					// envelopes during synthesis
 
-#define PI			3.1415926535897932
+#define MAX_BATCH		64	// most transforms of equal length done
+					// with a single plan
+#define BATCH_LEN		(1 << 22)	// most samples in such a batch
+#define DOWNS_COST		10.0	// cost of the downsampling of a band
+					// per input sample, in FFT passes
+#define HALFBAND_TAPS		16	// taps of the halfband filter on either
+					// side of its centre, besides zeros
+#define OCTAVE_PASS		0.4	// highest band edge analysed at a
+					// decimated rate, relative to the rate
+#define MAX_LEVEL_PPS		0.25	// highest column rate at a decimated
+					// rate, relative to the rate
+#define MAX_LEVELS		16
+#define CHUNK_LEN		(1 << 30)	// most samples given to a kernel
 
-extern double logbase;
+#define PI			3.1415926535897932
 
-//=====================================================================
+#define SUBBAND_HOP(Md)		((Md) > 1 ? (Md) / 2 : 1)	// between the
+					// sub-bands of frequency domain decimation
 
-// performs a Fast Fourier Transform
-// method: 0 = DFT  1 = IDFT  2 = DHT
+#define CHECK_RATE		44100	// sample rate of the precision check
+#define CHECK_LEN		(5 * CHECK_RATE)	// & its length
+#define CHECK_BANDS		110
+#define CHECK_VERSION		2	// of its reference file
 
-void
-fft(double *in, double *out, int32_t N, uint8_t method)
-{
-  fftw_plan p = fftw_plan_r2r_1d(N, in, out, method, FFTW_ESTIMATE);
-  fftw_execute(p);
-  fftw_destroy_plan(p);
-}
+extern double logbase;
+extern int32_t freq_decim;
+extern int32_t multirate;
+extern int32_t threads;
+extern double seg_len;
+extern int32_t quiet;
 
 //=====================================================================
 
-// normalises a signal to the +/-ratio range
+// normalises a signal of n samples to the +/-ratio range
 
-void
-normi(double **s, int32_t xs, int32_t ys, double ratio)
+static void
+normalise(real *s, size_t n, double ratio)
 {
-  int32_t ix, iy, maxx, maxy;
-  double max;
+  size_t i;
+  int32_t len;
+  double max, m;
 
   max = 0;
-  for (iy = 0; iy < ys; iy++)
-    for (ix = 0; ix < xs; ix++)
-      if (fabs(s[iy][ix]) > max)
-      {
-	max = fabs(s[iy][ix]);
-	maxx = ix;
-	maxy = iy;
-      }
+  for (i = 0; i < n; i += len)
+  {
+    len = n - i < CHUNK_LEN ? n - i : CHUNK_LEN;
+    m = kern.abs_max(&s[i], len);
+    if (m > max)
+      max = m;
+  }
 
   if (max != 0.0)
   {
@@ -75,9 +94,11 @@ normi(double **s, int32_t xs, int32_t ys, double ratio)
   else
     max = 0.0;
 
-  for (iy = 0; iy < ys; iy++)
-    for (ix = 0; ix < xs; ix++)
-      s[iy][ix] *= max;
+  for (i = 0; i < n; i += len)
+  {
+    len = n - i < CHUNK_LEN ? n - i : CHUNK_LEN;
+    kern.scale(&s[i], len, max);
+  }
 }
 
 //=====================================================================
@@ -153,364 +174,1241 @@ freqarray(double basefreq, int32_t bands, double bandsperoctave)
 
 //=====================================================================
 
-// Downsampling of the signal by a Blackman function
-// Mi is the original signal's length
-// Mo is the output signal's length
+// returns the length of the filtered signal (Mc) of band 'ib' of the
+// analysis
 
-double *
-blackman_downsampling(double *in, int32_t Mi, int32_t Mo)
+static int32_t
+band_len(bank_t *bank, int32_t ib, int32_t Md)
 {
-  int32_t i, j;			// general purpose iterators
+  int32_t Mc, Fa, Fd;
 
-  double *out,
-         pos_in,		// position in the original signal
-         x,			// position of the iterator in the blackman(x) formula
-         ratio,			// scaling ratio (> 1.0)
-         ratio_i,		// ratio^-1
-         coef,			// Blackman coefficient
-         coef_sum;		// sum of coefficients, used for weighting
+  Fa = bank->Fa[ib];
+  Fd = bank->Fd[ib];
 
-  ratio = (double) Mi / Mo;
-  ratio_i = 1.0 / ratio;
+  // with frequency domain decimation a band wider than Md bins is cut
+  // into sub-bands of Md bins overlapping by half, each transformed
+  // separately (see split_subbands())
+  if (freq_decim)
+    return Fd - Fa < Md ? Md : ((Fd - Fa) / SUBBAND_HOP(Md) + 2) * Md;
 
-  out = calloc(Mo, sizeof(double));
+  Mc = (Fd - Fa) * 2 + 1;	// '*2' because the filtering is on both
+  				// real and imaginary parts, '+1' for the DC.
+  				// No Nyquist component since the signal
+  				// length is necessarily odd
 
-  for (i = 0; i < Mo; i++)
-  {
-    pos_in = (double) i *ratio;
-    coef_sum = 0;
+  if (Md > Mc)			// if the band is going to be too narrow
+    Mc = Md;
+
+  // round the larger bands up to the cheapest transform size
+  if (Md < Mc)
+    Mc = fft_size(Mc, FFT_SIZE_COMPLEX);
+
+  return Mc;
+}
+
+//=====================================================================
+
+// cuts the spectrum t of a band (n complex elements from the DC up) into
+// the sub-bands of frequency domain decimation, put one after the other
+// in z: sub-band k holds the elements from (k - 1) * Md / 2 on, weighted
+// by a sine window. Where two sub-bands overlap the squares of their
+// weights add up to 1, so the energies of the sub-bands add up to that
+// of the band wherever a tone lies, and no edge rings like a square cut
+// would. z must hold ((n - 1) / SUBBAND_HOP(Md) + 2) * Md elements,
+// zeroed.
+
+static void
+split_subbands(real *z, real *t, int32_t n, int32_t Md)
+{
+  int32_t i, k, p, H, nw;
+  double *v;
 
-    for (j = roundup(pos_in - ratio); j <= pos_in + ratio; j++)
+  H = SUBBAND_HOP(Md);
+  nw = Md > 1 ? 2 * H : 1;		// a single column can't overlap
+  v = malloc(nw * sizeof(double));
+
+  for (i = 0; i < nw; i++)
+    v[i] = sin(PI * (i + 0.5) / nw);
+
+  for (k = 0; (k - 1) * H < n; k++)
+    for (i = 0; i < nw; i++)
     {
-      if (j >= 0 && j < Mi)	// if the read sample is within bounds
-      {
-	x = j - pos_in + ratio;	// calculate position within the Blackman function
-	coef = 0.42 - 0.5 * cos(PI * x * ratio_i) + 0.08 * cos(2 * PI * x * ratio_i);
-	coef_sum += coef;
-	out[i] += in[j] * coef;	// convolve
-      }
-    }
+      p = (k - 1) * H + i;
+      if (p < 0 || p >= n)
+        continue;
 
-    out[i] /= coef_sum;
-  }
+      z[(k * Md + i) * 2] = t[p * 2] * v[i];
+      z[(k * Md + i) * 2 + 1] = t[p * 2 + 1] * v[i];
+    }
 
-  return out;
+  free(v);
 }
 
 //=====================================================================
 
-// Blackman Square look-up table generator
+// turns the analytic signal of a band (Mc complex elements) into its
+// envelope, Md samples long once downsampled by r and chopped to Xsize.
+// With frequency domain decimation z holds Mc / Md sub-bands already at
+// the column rate (see split_subbands()), and the envelope is the root
+// of the sum of their energies, which needs no downsampling.
 
-double *
-bmsq_lut(int32_t size)
+static real *
+band_envelope(real *z, int32_t Mc, int32_t Md, int32_t Xsize, resampler_t *r)
 {
-  int32_t i;			// general purpose iterator
+  int32_t i, k;
+  real *out, *t;
 
-  double *lut;
-  double coef;			// Blackman square final coefficient
-  double bar = PI * (3.0 / (double) size) * (1.0 / 1.5);
-  double foo;
+  if (freq_decim && Mc > Md)
+  {
+    out = buf_calloc(Md);
+    t = buf_alloc(Md);
 
-  // Blackman Square coefficients
-  double f1  = -0.6595044010905501;
-  double f2  = 0.1601741366715479;
-  double f4  = -0.0010709178680006;
-  double f5  = 0.0001450093579222;
-  double f7  = 0.0001008528049040;
-  double f8  = 0.0000653092892874;
-  double f10 = 0.0000293385615146;
-  double f11 = 0.0000205351559060;
-  double f13 = 0.0000108567682890;
-  double f14 = 0.0000081549460136;
-  double f16 = 0.0000048519309366;
-  double f17 = 0.0000038284344102;
-  double f19 = 0.0000024753630724;
+    for (k = 0; k < Mc; k += Md)
+    {
+      kern.magnitude(t, &z[k * 2], Md);
+      kern.mul_acc(out, t, t, Md);
+    }
 
-  size++;			// allows to read value 3.0
+    for (i = 0; i < Md; i++)
+      out[i] = sqrt(out[i]);
 
-  lut = calloc(size, sizeof(double));
+    buf_free(t);
 
-  for (i = 0; i < size; i++)
-  {
-    foo = (double) i *bar;
-    coef = 0;
+    return buf_resize(out, Xsize);	// Tail chopping
+  }
 
-    coef += cos(foo) * f1 - f1;
-    coef += cos(2.0 * foo) * f2 - f2;
-    coef += cos(4.0 * foo) * f4 - f4;
-    coef += cos(5.0 * foo) * f5 - f5;
-    coef += cos(7.0 * foo) * f7 - f7;
-    coef += cos(8.0 * foo) * f8 - f8;
-    coef += cos(10.0 * foo) * f10 - f10;
-    coef += cos(11.0 * foo) * f11 - f11;
-    coef += cos(13.0 * foo) * f13 - f13;
-    coef += cos(14.0 * foo) * f14 - f14;
-    coef += cos(16.0 * foo) * f16 - f16;
-    coef += cos(17.0 * foo) * f17 - f17;
-    coef += cos(19.0 * foo) * f19 - f19;
+  out = buf_alloc(Mc);	// allocate new band
 
-    lut[i] = coef;
+  kern.magnitude(out, z, Mc);	// Magnitude of the analytic signal
+
+  //=============
+  // Downsampling
+  //=============
+
+  // if the band doesn't have to be resampled
+  // simply ignore the end of it
+  if (Mc < Md)
+    out = buf_resize(out, Md);
+
+  if (Mc > Md)			// If the band must be downsampled
+  {
+    t = out;
+    out = buf_alloc(Md);
+    resample_run(r, t, out);
+    buf_free(t);
   }
 
-  return lut;
+  return buf_resize(out, Xsize);	// Tail chopping
 }
 
 //=====================================================================
 
-// Interpolation based on an estimate of the Blackman Square function,
-// which is a Blackman function convolved with a square. It's like
-// smoothing the result of a nearest neighbour interpolation with a
-// Blackman FIR
+// where the analysis puts its columns: into the columns dst .. of an
+// image from its row y0 down, quantised by q if it's an 8-bit one, or
+// else as whole rows
+// given to put() as soon as their band is done, by the thread that did
+// it. With neither an image nor put(), only the largest value is kept.
 
-// Mi is the original signal's length
-// Mo is the output signal's length
+typedef struct
+{
+  image_t *image;
+  int32_t dst, y0;
+  int32_t bands;		// the number of rows
+  quant_t *q;
+  row_fn_t put;
+  void *put_ctx;
+  double max;			// the largest value put so far
+} anal_out_t;
 
-void
-blackman_square_interpolation
-(
-  double *in, double *out, int32_t Mi, int32_t Mo,
-  double *lut, int32_t lut_size
-)
+//=====================================================================
+
+// what the band tasks of the analysis share. Each batch of bands is
+// one task, and every worker has its own buffers.
+
+typedef struct
 {
-  int32_t i, j;			// general purpose iterators
-  int32_t j_start, j_stop;	// boundary values for the j loop
-  int32_t pos_luti;		// Integer index on the look-up table
+  real *s;			// spectrum of the whole signal
+  anal_out_t *out;
+  int32_t col0, ncols;		// columns kept
+  real gain;			// applied to the columns kept
+  int32_t Mb, Md;
+  bank_t *bank;			// the filters of the bands
+  int32_t *first, *count;	// first band & number of bands of each batch
+  resampler_t **rs;		// the downsampling of each batch, if any
+  real **z, **w;		// the buffers of each worker
+  int32_t *zsize;		// the sizes of z
+  double *max;			// the largest value put by each worker
+} anal_ctx_t;
 
-  double pos_in,		// position in the original signal
-         x,			// position of the iterator in the
-         			// blackman_square(x) formula
-         ratio,			// scaling ratio (> 1.0)
-         ratio_i,		// ratio^-1
-         coef,			// Blackman square final coefficient
-         pos_lut,		// Index on the look-up table
-         mod_pos,		// modulo of the position on the look-up table
-         y0, y1,		// values of the two closest values on the LUT
-         foo;
+//=====================================================================
 
-  foo = (double) lut_size / 3.0;
-  ratio = (double) Mi / Mo;
-  ratio_i = 1.0 / ratio;
+// filters, transforms and detects the envelopes of one batch of bands
 
-  for (i = 0; i < Mo; i++)
+static void
+anal_batch(void *ctx, int32_t task, int32_t worker)
+{
+  anal_ctx_t *c = (anal_ctx_t *) ctx;
+  int32_t i, j, ib, iy, nb, Mb, Md, Fa, Fd, zlen, off, L, n;
+  int32_t Mcb[MAX_BATCH];
+  real *z, *zb, *w, *t, *env, *row;
+  double m;
+
+  ib = c->first[task];
+  nb = c->count[task];
+  Mb = c->Mb;
+  Md = c->Md;
+
+  for (j = zlen = 0; j < nb; j++)
   {
-    pos_in = (double) i *ratio;
-    j_stop = pos_in + 1.5;
+    Mcb[j] = band_len(c->bank, ib + j, Md);
+    zlen += Mcb[j];
+  }
+
+  if (zlen > c->zsize[worker])	// grow the analytic signals' buffer if needed
+  {
+    c->zsize[worker] = zlen;
+    buf_free(c->z[worker]);
+    c->z[worker] = buf_alloc(zlen * 2);
+  }
+
+  z = c->z[worker];
+  memset(z, 0, zlen * 2 * sizeof(real));
+
+  for (j = off = 0; j < nb; off += Mcb[j++])
+  {
+    //===========
+    // Filtering 
+    //===========
+
+    Fa = c->bank->Fa[ib + j];
+    Fd = c->bank->Fd[ib + j];
+    zb = &z[off * 2];
 
-    j_start = j_stop - 2;
-    if (j_start < 0)
-      j_start = 0;
+    //=====================================================
+    // One-sided spectrum of the analytic signal. The real
+    // and imaginary parts are taken from the half-complex
+    // spectrum, the negative frequencies are left to zero.
+    // They should be doubled, but the image is normalised
+    //=====================================================
 
-    // The boundary check is done after j_start is calculated to avoid
-    // miscalculating it
-    if (j_stop >= Mi)
-      j_stop = Mi - 1;
+    if (c->bank->w == NULL && c->w[worker] == NULL)
+      c->w[worker] = buf_alloc(c->bank->wmax);
 
-    for (j = j_start; j <= j_stop; j++)
+    w = bank_weights(c->bank, ib + j, c->w[worker]);
+
+    // Re from s[Fa + 1] upwards, Im from s[Mb - Fa - 1] downwards
+    if (freq_decim && Mcb[j] > Md)
     {
-      x = j - pos_in + 1.5;		// calculate position within the
-      					// Blackman square function in the
-      					// [0.0 ; 3.0] range
-      pos_lut = x * foo;
-      pos_luti = (int32_t) pos_lut;
+      t = buf_calloc((Fd - Fa + 1) * 2);
+      kern.window(&t[2], &c->s[Fa + 1], &c->s[Mb - Fa - 1], w, Fd - Fa);
+      split_subbands(zb, t, Fd - Fa + 1, Md);
+      buf_free(t);
+    }
+    else
+      kern.window(&zb[2], &c->s[Fa + 1], &c->s[Mb - Fa - 1], w, Fd - Fa);
+  }
+
+  //===================
+  // Envelope detection
+  //===================
 
-      mod_pos = fmod(pos_lut, 1.0);	// modulo of the index
+  // In-place complex IFFTs of the filtered band signals, MAX_BATCH
+  // at a time to bound the number of plans
+  L = freq_decim ? Md : Mcb[0];
+  for (i = 0; i < zlen / L; i += n)
+  {
+    n = zlen / L - i;
+    if (n > MAX_BATCH)
+      n = MAX_BATCH;
 
-      y0 = lut[pos_luti];		// interpolate linearly between the
-      					// two closest values
-      y1 = lut[pos_luti + 1];
-      coef = y0 + mod_pos * (y1 - y0);	// linear interpolation
+    fft_complex_many(&z[i * L * 2], &z[i * L * 2], L, n, 1);
+  }
 
-      out[i] += in[j] * coef;		// convolve
+  for (j = off = 0; j < nb; off += Mcb[j++])
+  {
+    iy = c->out->bands - ib - j - 1;
+    env = band_envelope(&z[off * 2], Mcb[j], Md, c->col0 + c->ncols,
+                        c->rs[task]);
+
+    if (c->gain != 1.0)
+      kern.scale(&env[c->col0], c->ncols, c->gain);
+
+    m = kern.abs_max(&env[c->col0], c->ncols);	// while it's in the cache
+    if (m > c->max[worker])
+      c->max[worker] = m;
+
+    if (c->out->put != NULL)
+      c->out->put(c->out->put_ctx, iy, &env[c->col0]);
+    else if (c->out->q != NULL)
+      quant_row(c->out->q,
+                &image_row_u8(c->out->image, c->out->y0 + iy)[c->out->dst],
+                &env[c->col0], c->ncols);
+    else if (c->out->image != NULL)
+    {
+      row = &image_row(c->out->image, c->out->y0 + iy)[c->out->dst];
+      memcpy(row, &env[c->col0], c->ncols * sizeof(real));
     }
+
+    buf_free(env);
   }
 }
 
 //=====================================================================
 
-// s = the original signal
-// samplecount = the original signal's orginal length
+// returns the length of the zero padding that keeps the band filters,
+// which are circular, from wrapping the end of the signal around to its
+// start. As the filters are symmetric, they reach half as far on
+// either side of a sample.
 
-double **
-anal
+static int32_t
+filter_reach(double *freq, double bpo)
+{
+  double pow1;
+
+  if (logbase == 1.0)		// linear mode
+    return (int32_t) roundoff(5.0 / freq[1] - freq[0]);
+
+  pow1 = pow(logbase, -1.0 / bpo);
+
+  return (int32_t) roundoff(2.0 * 5.0 / ((freq[0] * pow1) * (1.0 - pow1)));
+}
+
+//=====================================================================
+
+// analyses the signal s (n samples, resized and overwritten) with the
+// bands ib0 .. ib1 - 1, padded by 'reach' samples, and puts its columns
+// col0 .. col0 + ncols - 1 into out. The bands are processed by nthreads
+// threads, the signal FFT too if nthreads > 1. The envelopes grow with
+// the padded length Mb, so if 'scaled' the columns are divided by it to
+// match those of other segments or rates. Returns s, which may have
+// moved.
+
+static real *
+anal_signal
 (
-  double *s, int32_t samplecount, int32_t samplerate, int32_t *Xsize,
-  int32_t bands, double bpo, double pixpersec, double basefreq
+  real *s, int32_t n, anal_out_t *out, int32_t col0, int32_t ncols,
+  int32_t ib0, int32_t ib1, int32_t reach, double pixpersec,
+  double basefreq, double maxfreq, int32_t scaled, int32_t nthreads
 )
 {
-  int32_t i, ib, Mb, Mc, Md, Fa, Fd;
-  double **out, *h, *freq, *t, coef, La, Ld, Li, maxfreq;
+  int32_t i, ib, nb, nbatch, nrs, Mb, Mc, Md, zlen, L;
+  double *cost;
+  resampler_t **rs;
+  anal_ctx_t c;
 
   /*
      ib    = the band iterator
-     i     = a general purpose iterator
+     i     = general purpose iterator
+     nb    = the number of bands transformed together
+     nbatch = the number of batches
+     zlen  = the sum of the lengths of the batch
+     L     = the length of the transforms of the batch
+     cost  = the estimated cost of every batch
+     rs    = the resamplers of the downsampled bands, one per length
+     nrs   = the number of resamplers
      Mb    = the length of the original signal once zero-padded (always even)
-     Mc    = the length of the filtered signal
+     Mc    = the length of the filtered signal (a multiple of Md made of
+             several sub-bands with frequency domain decimation)
      Md    = the length of the envelopes once downsampled (constant)
-     Fa    = the index of the band's start in the frequency domain
-     Fd    = the index of the band's end in the frequency domain
-     La    = the log2 of the frequency of Fa
-     Ld    = the log2 of the frequency of Fd
-     Li    = the iterative frequency between La and Ld defined logarithmically
-     coef  = a temporary modulation coefficient
-     t     = temporary pointer to a new version of the signal being worked on
-     bands = the total count of bands
-     freq  = the band's central frequency
      maxfreq = the central frequency of the last band
    */
 
-  freq = freqarray(basefreq, bands, bpo);
+  //===================================
+  // zero padding 
+  // Note: don't do it in circular mode
+  //===================================
 
-  // in linear mode we use bpo to store the maxfreq since we couldn't
-  // deduce maxfreq otherwise
-  if (logbase == 1.0)
-    maxfreq = bpo;
+  Mb = n - 1 + reach;
+
+  if (Mb % 2 == 1)
+    Mb++;				// make it even (for simplicity)
+
+  Mb = roundoff((double) fft_size((int32_t) roundoff(Mb * pixpersec), FFT_SIZE_COMPLEX) / pixpersec);
+  Md = roundoff(Mb * pixpersec);
+
+  s = buf_resize(s, Mb);	// resize to the zeropadded size
+  memset(&s[n], 0, (Mb - n) * sizeof(real));
+
+  // In-place FFT of the original zero-padded signal
+  if (nthreads > 1)
+    fft_threaded(s, s, Mb, 0);
   else
-    maxfreq = basefreq * pow(logbase, ((double) (bands - 1) / bpo));
+    fft(s, s, Mb, 0);
+
+  //======================================================
+  // The bands too narrow to need downsampling all have
+  // the same length Md, consecutive ones are transformed
+  // together in batches. With frequency domain decimation
+  // all the transforms are Md long, so any band can join.
+  // The batches are independent, they only read s and
+  // write their own rows, so they are spread over the
+  // threads, the most expensive first
+  //======================================================
+
+  c.bank = bank_get(Mb, out->bands, basefreq, maxfreq, nthreads);
+  c.first = malloc((ib1 - ib0) * sizeof(int32_t));
+  c.count = malloc((ib1 - ib0) * sizeof(int32_t));
+  c.rs = calloc(ib1 - ib0, sizeof(resampler_t *));
+  rs = malloc((ib1 - ib0) * sizeof(resampler_t *));
+  cost = malloc((ib1 - ib0) * sizeof(double));
+
+  for (ib = ib0, nbatch = nrs = 0; ib < ib1; ib += nb, nbatch++)
+  {
+    Mc = band_len(c.bank, ib, Md);
+    L = freq_decim ? Md : Mc;
 
-  *Xsize = samplecount * pixpersec;
+    // the bands to downsample are alone in their batch, and those of
+    // the same length share the coefficients of their resampler
+    if (Mc > Md && ! freq_decim)
+    {
+      for (i = 0; i < nrs && rs[i]->Mi != Mc; i++);
 
-  if (fmod((double) samplecount * pixpersec, 1.0) != 0.0)	// round-up
-    (*Xsize)++;
+      if (i == nrs)
+        rs[nrs++] = resample_new(Mc, Md, RESAMPLE_BLACKMAN);
 
-  message("Image size: %d(W)x%d(H)", *Xsize, bands);
-  out = malloc(bands * sizeof(double *));
+      c.rs[nbatch] = rs[i];
+    }
 
-  //===================================
-  // zero padding 
-  // Note: don't do it in circular mode
-  //===================================
+    nb = 1;
+    zlen = Mc;
+    cost[nbatch] = Mc > Md && ! freq_decim ? Mc * DOWNS_COST : 0.0;
 
-  if (logbase == 1.0)		// linear mode
-    Mb = samplecount - 1 + (int32_t) roundoff(5.0 / freq[1] - freq[0]);
-  else
+    if (Mc == Md || freq_decim)
+      while (nb < MAX_BATCH && ib + nb < ib1)
+      {
+        Mc = band_len(c.bank, ib + nb, Md);
+        if ((Mc != Md && ! freq_decim) || zlen + Mc > BATCH_LEN)
+          break;
+
+        nb++;
+        zlen += Mc;
+      }
+
+    c.first[nbatch] = ib;
+    c.count[nbatch] = nb;
+    cost[nbatch] += zlen * log2(L);
+  }
+
+  c.s = s;
+  c.out = out;
+  c.col0 = col0;
+  c.ncols = ncols;
+  c.gain = scaled ? 1.0 / Mb : 1.0;
+  c.Mb = Mb;
+  c.Md = Md;
+  c.z = calloc(nthreads, sizeof(real *));
+  c.w = calloc(nthreads, sizeof(real *));
+  c.zsize = calloc(nthreads, sizeof(int32_t));
+  c.max = calloc(nthreads, sizeof(double));
+
+  pool_run(nbatch, cost, anal_batch, &c, nthreads);
+
+  for (i = 0; i < nthreads; i++)
   {
-    double pow1 = pow(logbase, -1.0 / bpo);
-    Mb = samplecount - 1;
-    Mb += (int32_t) roundoff(2.0 * 5.0 / ((freq[0] * pow1) * (1.0 - pow1)));
+    if (c.max[i] > out->max)
+      out->max = c.max[i];
+
+    buf_free(c.z[i]);
+    buf_free(c.w[i]);
   }
 
-  if (Mb % 2 == 1)
-    Mb++;				// make it even (for simplicity)
+  free(c.z);
+  free(c.w);
+  free(c.zsize);
+  free(c.max);
 
-  Mb = roundoff((double) nextsprime((int32_t) roundoff(Mb * pixpersec)) / pixpersec);
-  Md = roundoff(Mb * pixpersec);
+  for (i = 0; i < nrs; i++)
+    resample_free(rs[i]);
 
-  s = realloc(s, Mb * sizeof(double));	// realloc to the zeropadded size
-  memset(&s[samplecount], 0, (Mb - samplecount) * sizeof(double));
+  free(rs);
+  free(c.rs);
+  free(c.first);
+  free(c.count);
+  free(cost);
+  bank_release(c.bank);
 
-  fft(s, s, Mb, 0);	// In-place FFT of the original zero-padded signal
+  return s;
+}
+
+//=====================================================================
+
+// returns the 2 * HALFBAND_TAPS taps of the halfband filter of the
+// multirate analysis but its centre one (1/2), tap i being at the odd
+// distance 2 * (i - HALFBAND_TAPS) + 1 from the centre, and gives their
+// number in ntaps
+
+real *
+halfband_taps(int32_t *ntaps)
+{
+  int32_t i, d;
+  real *h;
+  double x, sum;
+
+  h = buf_alloc(2 * HALFBAND_TAPS);
+  sum = 0.0;
+  for (i = 0; i < 2 * HALFBAND_TAPS; i++)
+  {
+    d = 2 * (i - HALFBAND_TAPS) + 1;			// distance to the centre
+    x = (double) (d + 2 * HALFBAND_TAPS) / (4.0 * HALFBAND_TAPS);
+    h[i] = sin(PI * d / 2.0) / (PI * d) *
+           (0.42 - 0.5 * cos(2.0 * PI * x) + 0.08 * cos(4.0 * PI * x));
+    sum += h[i];
+  }
+
+  for (i = 0; i < 2 * HALFBAND_TAPS; i++)		// unity gain at DC
+    h[i] *= 0.5 / sum;
+
+  *ntaps = 2 * HALFBAND_TAPS;
+
+  return h;
+}
+
+//=====================================================================
+
+// returns the deepest level of the multirate pyramid (the signal
+// decimated by 2 that many times) at which a band whose upper edge is at
+// f can be analysed into columns at pixpersec, both relative to the
+// rate: its edge still well within the band that the decimation leaves
+// intact
+
+int32_t
+pyramid_level(double f, double pixpersec)
+{
+  int32_t k;
+
+  for (k = 0; k + 1 < MAX_LEVELS &&
+              f * (2 << k) <= OCTAVE_PASS &&
+              pixpersec * (2 << k) <= MAX_LEVEL_PPS; k++);
+
+  return k;
+}
+
+//=====================================================================
+
+// decimates the signal in (n samples) by 2 with a halfband filter,
+// centred so that sample j of the output is at sample 2j of the input,
+// and gives the length of the output in m. Only the frequencies below
+// a fifth of the input rate come out unaltered: the transition band
+// aliases to the top of the output band.
+
+static real *
+halfband_decimate(real *in, int32_t n, int32_t *m)
+{
+  int32_t i, j, nodd, ntaps;
+  real *h, *odd, *out;
+
+  // the taps but the centre one (1/2) are at odd distances from it, so
+  // they are only applied to the odd input samples
+
+  h = halfband_taps(&ntaps);
+
+  nodd = n / 2;
+  odd = buf_calloc(nodd + 2 * HALFBAND_TAPS);	// zeros on either side
+  for (i = 0; i < nodd; i++)
+    odd[HALFBAND_TAPS + i] = in[2 * i + 1];
+
+  *m = (n + 1) / 2;
+  out = buf_alloc(*m);
+  for (j = 0; j < *m; j++)
+    out[j] = 0.5 * in[2 * j] + kern.dot(&odd[j], h, ntaps);
+
+  buf_free(odd);
+  buf_free(h);
+
+  return out;
+}
+
+//=====================================================================
+
+// analyses the signal s like anal_signal() with all the bands. In
+// multirate mode every octave is analysed at the lowest rate that still
+// holds it, from a pyramid of signals decimated by 2 at every level,
+// each level with the padding and the margins its lowest band needs.
+
+static real *
+anal_levels
+(
+  real *s, int32_t n, anal_out_t *out, int32_t col0, int32_t ncols,
+  double *freq, double bpo, double pixpersec, double basefreq,
+  double maxfreq, int32_t scaled, int32_t nthreads
+)
+{
+  int32_t i, k, nlev, ib, ib1, bands, margin, m0, a, b, len[MAX_LEVELS];
+  int32_t *level;
+  real *sig[MAX_LEVELS], *seg;
+  double f, scale;
+
+  bands = out->bands;
+
+  if (! multirate || logbase == 1.0)
+    return anal_signal(s, n, out, col0, ncols, 0, bands,
+                       filter_reach(freq, bpo), pixpersec, basefreq,
+                       maxfreq, scaled, nthreads);
+
+  // the deepest level of every band, where its upper edge is still well
+  // within the band that the decimation leaves intact
+
+  level = malloc(bands * sizeof(int32_t));
+  nlev = 1;
 
   for (ib = 0; ib < bands; ib++)
   {
-    //===========
-    // Filtering 
-    //===========
+    f = log_pos((double) (ib + 1) / (double) (bands - 1), basefreq, maxfreq);
+    k = pyramid_level(f, pixpersec);
 
-    Fa =
-      roundoff(log_pos ((double) (ib - 1) / (double) (bands - 1), basefreq, maxfreq) * Mb);
-    Fd =
-      roundoff(log_pos ((double) (ib + 1) / (double) (bands - 1), basefreq, maxfreq) * Mb);
-    La = log_pos_inv((double) Fa / (double) Mb, basefreq, maxfreq);
-    Ld = log_pos_inv((double) Fd / (double) Mb, basefreq, maxfreq);
+    level[ib] = k;
+    if (k + 1 > nlev)
+      nlev = k + 1;
+  }
+
+  // the pyramid, built before the analysis overwrites s
 
-    if (Fd > Mb / 2)
-      Fd = Mb / 2;		// stop reading if reaching the Nyquist frequency
+  sig[0] = s;
+  len[0] = n;
+  for (k = 1; k < nlev; k++)
+    sig[k] = halfband_decimate(sig[k - 1], len[k - 1], &len[k]);
 
-    if (Fa < 1)
-      Fa = 1;
+  // the levels, from the deepest up, each one with its own bands
 
-    Mc = (Fd - Fa) * 2 + 1;	// '*2' because the filtering is on both
-    				// real and imaginary parts, '+1' for the DC.
-    				// No Nyquist component since the signal
-    				// length is necessarily odd
+  for (ib = 0; ib < bands; ib = ib1)
+  {
+    k = level[ib];
+    for (ib1 = ib + 1; ib1 < bands && level[ib1] == k; ib1++);
 
-    if (Md > Mc)		// if the band is going to be too narrow
-      Mc = Md;
+    scale = (double) (1 << k);
+    margin = roundup(filter_reach(&freq[ib], bpo) / 2 * pixpersec);
 
-    // round the larger bands up to the next integer made of 2^n * 3^m
-    if (Md < Mc)
-      Mc = nextsprime(Mc);
+    m0 = col0 - margin;				// the samples needed
+    if (m0 < 0)
+      m0 = 0;
 
-    out[bands - ib - 1] = calloc(Mc, sizeof(double));	// allocate new band
+    a = roundoff(m0 / (pixpersec * scale));
+    b = roundoff((col0 + ncols + margin) / (pixpersec * scale));
+    if (b > len[k])
+      b = len[k];
 
-    for (i = 0; i < Fd - Fa; i++)
+    if (k == 0 && a == 0 && b == len[0])		// the whole signal
+      seg = s;
+    else
     {
-      Li = log_pos_inv((double) (i + Fa) / (double) Mb, basefreq, maxfreq);	// calculation of the logarithmic position
-      Li = (Li - La) / (Ld - La);
-      coef = 0.5 - 0.5 * cos(2.0 * PI * Li);	// Hann function
-      out[bands - ib - 1][i + 1] = s[i + 1 + Fa] * coef;
-      out[bands - ib - 1][Mc - 1 - i] = s[Mb - Fa - 1 - i] * coef;
+      seg = buf_alloc(b - a);
+      memcpy(seg, &sig[k][a], (b - a) * sizeof(real));
     }
 
-    //===================================
-    // 90 rotation (Re' = Im; Im' = -Re)
-    //===================================
+    seg = anal_signal(seg, b - a, out, col0 - m0, ncols, ib, ib1,
+                      roundup(filter_reach(&freq[ib], bpo) / scale),
+                      pixpersec * scale, basefreq * scale, maxfreq * scale,
+                      1, nthreads);
 
-    h = calloc(Mc, sizeof(double));	// allocate the 90 rotated version
+    if (k == 0 && a == 0 && b == len[0])
+      s = seg;
+    else
+      buf_free(seg);
+  }
 
-    for (i = 0; i < Fd - Fa; i++)
-    {
-      h[i + 1] = out[bands - ib - 1][Mc - 1 - i];	// Re' = Im
-      h[Mc - 1 - i] = -out[bands - ib - 1][i + 1];	// Im' = -Re
-    }
+  for (i = 1; i < nlev; i++)
+    buf_free(sig[i]);
 
-    //===================
-    // Envelope detection
-    //===================
+  free(level);
+
+  return s;
+}
+
+//=====================================================================
+
+// returns the central frequency of the last band
+
+static double
+max_freq(double basefreq, int32_t bands, double bpo)
+{
+  // in linear mode we use bpo to store the maxfreq since we couldn't
+  // deduce maxfreq otherwise
+  if (logbase == 1.0)
+    return bpo;
+
+  return basefreq * pow(logbase, ((double) (bands - 1) / bpo));
+}
+
+//=====================================================================
+
+// returns the number of columns to analyse on either side of a block of
+// columns analysed on its own, for the band filters to settle
+
+int32_t
+anal_margin(int32_t bands, double bpo, double pixpersec, double basefreq)
+{
+  int32_t margin;
+  double *freq;
+
+  freq = freqarray(basefreq, bands, bpo);
+  margin = roundup(filter_reach(freq, bpo) / 2 * pixpersec);
+  free(freq);
+
+  return margin;
+}
+
+//=====================================================================
+
+// gives the samples a .. b - 1 to analyse for the columns x0 .. x1 - 1
+// with 'margin' columns on either side, returns the first column they
+// give
+
+int32_t
+anal_span(int32_t x0, int32_t x1, int32_t margin, int32_t samplecount,
+          double pixpersec, int32_t *a, int32_t *b)
+{
+  int32_t m0;
+
+  m0 = x0 - margin;
+  if (m0 < 0)
+    m0 = 0;
+
+  *a = roundoff(m0 / pixpersec);
+  *b = roundoff((x1 + margin) / pixpersec);
+  if (*b > samplecount)
+    *b = samplecount;
+
+  return m0;
+}
+
+//=====================================================================
+
+// analyses the columns x0 .. x1 - 1 of a signal of samplecount samples
+// on their own, and puts them into out with nthreads threads. s holds
+// the samples from 'first' on, at least those given by anal_span().
+
+static void
+anal_part
+(
+  real *s, int32_t first, int32_t samplecount, int32_t x0, int32_t x1,
+  int32_t margin, anal_out_t *out, double bpo, double pixpersec,
+  double basefreq, int32_t nthreads
+)
+{
+  int32_t a, b, m0;
+  double *freq;
+  real *seg;
+
+  m0 = anal_span(x0, x1, margin, samplecount, pixpersec, &a, &b);
+
+  seg = buf_alloc(b - a);
+  memcpy(seg, &s[a - first], (b - a) * sizeof(real));
+
+  freq = freqarray(basefreq, out->bands, bpo);
+  seg = anal_levels(seg, b - a, out, x0 - m0, x1 - x0, freq, bpo,
+                    pixpersec, basefreq, max_freq(basefreq, out->bands, bpo),
+                    1, nthreads);
+
+  free(freq);
+  buf_free(seg);
+}
+
+//=====================================================================
+
+// analyses the columns x0 .. x1 - 1 of a signal of samplecount samples
+// on their own, and puts them into the columns dst .. of the image out,
+// which has a row per band. s holds the samples from 'first' on, at
+// least those given by anal_span(). The results match those of other
+// blocks, so the image can be put together from blocks done in any
+// order, by any thread. Returns the largest value put.
+
+double
+anal_block
+(
+  real *s, int32_t first, int32_t samplecount, int32_t x0, int32_t x1,
+  int32_t margin, image_t *out, int32_t dst, double bpo, double pixpersec,
+  double basefreq
+)
+{
+  anal_out_t o;
+
+  o.image = out;
+  o.dst = dst;
+  o.y0 = 0;
+  o.bands = out->height;
+  o.q = NULL;
+  o.put = NULL;
+  o.max = 0.0;
+
+  anal_part(s, first, samplecount, x0, x1, margin, &o, bpo, pixpersec,
+            basefreq, 1);
+
+  return o.max;
+}
+
+//=====================================================================
+
+// analyses the columns x0 .. x1 - 1 of a signal of samplecount samples
+// into an image of their own, like anal() but with a transform only as
+// long as the samples these columns need: s holds the samples from
+// 'first' on, at least those anal_span() gives with the margin of
+// anal_margin(). max = the largest value of the image, which is left
+// unnormalised.
+
+image_t *
+anal_region
+(
+  real *s, int32_t first, int32_t samplecount, int32_t x0, int32_t x1,
+  int32_t bands, double bpo, double pixpersec, double basefreq,
+  double *max
+)
+{
+  image_t *out;
+  anal_out_t o;
+
+  message("Image size: %d(W)x%d(H)", x1 - x0, bands);
+  out = image_new(x1 - x0, bands, IMAGE_REAL);
 
-    // In-place IFFT of the filtered band signal
-    fft(out[bands - ib - 1], out[bands - ib - 1], Mc, 1);
+  o.image = out;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = NULL;
+  o.max = 0.0;
 
-    // In-place IFFT of the filtered band signal rotated by 90
-    fft(h, h, Mc, 1);
+  anal_part(s, first, samplecount, x0, x1,
+            anal_margin(bands, bpo, pixpersec, basefreq), &o, bpo,
+            pixpersec, basefreq, threads);
 
-    // Magnitude of the analytic signal
-    for (i = 0; i < Mc; i++)
-      out[bands - ib - 1][i] =
-        sqrt(out[bands - ib - 1][i] * out[bands - ib - 1][i] + h[i] * h[i]);
+  *max = o.max;
 
-    free(h);
+  return out;
+}
+
+//=====================================================================
+
+// what the segment tasks of the analysis share
+
+typedef struct
+{
+  real *s;			// the whole signal
+  anal_out_t *out;		// what every segment puts its columns into
+  int32_t samplecount, Xsize;
+  int32_t seg_cols, margin;	// columns per segment & of overlap
+  double bpo, pixpersec, basefreq;
+  double *max;			// the largest value of each worker
+} seg_ctx_t;
+
+//=====================================================================
+
+// analyses segment 'task' with the overlap on both sides, and keeps
+// the columns of the segment itself
+
+static void
+anal_segment(void *ctx, int32_t task, int32_t worker)
+{
+  seg_ctx_t *c = (seg_ctx_t *) ctx;
+  int32_t x0, x1;
+  anal_out_t o;
 
-    //=============
-    // Downsampling
-    //=============
+  x0 = task * c->seg_cols;		// the columns of the segment
+  x1 = x0 + c->seg_cols;
+  if (x1 > c->Xsize)
+    x1 = c->Xsize;
 
-    // if the band doesn't have to be resampled
-    // simply ignore the end of it
-    if (Mc < Md)
-      out[bands - ib - 1] = realloc(out[bands - ib - 1], Md * sizeof(double));
+  o = *c->out;
+  o.dst = x0;
+  o.max = 0.0;
 
-    if (Mc > Md)		// If the band must be downsampled
+  anal_part(c->s, 0, c->samplecount, x0, x1, c->margin, &o, c->bpo,
+            c->pixpersec, c->basefreq, 1);
+
+  if (o.max > c->max[worker])
+    c->max[worker] = o.max;
+}
+
+//=====================================================================
+
+// returns the number of columns of the spectrogram of samplecount samples
+
+int32_t
+anal_width(int32_t samplecount, double pixpersec)
+{
+  int32_t Xsize;
+
+  Xsize = samplecount * pixpersec;
+
+  if (fmod((double) samplecount * pixpersec, 1.0) != 0.0)	// round-up
+    Xsize++;
+
+  return Xsize;
+}
+
+//=====================================================================
+
+// analyses the signal s (samplecount samples) into out with nthreads
+// threads, the image being Xsize columns wide, and sets out->max. Unless
+// 'keep', s is overwritten, and the returned signal replaces it.
+
+static real *
+anal_into
+(
+  real *s, int32_t samplecount, int32_t samplerate, int32_t Xsize,
+  double bpo, double pixpersec, double basefreq, anal_out_t *out,
+  int32_t keep, int32_t nthreads
+)
+{
+  int32_t i, nseg, bands;
+  double *freq, *cost;
+  real *t;
+  seg_ctx_t c;
+
+  bands = out->bands;
+  out->max = 0.0;
+
+  //=========================================================
+  // Time segments: every segment is analysed on its own with
+  // enough of the signal on both sides for the band filters
+  // to settle, and only its own columns are kept. The
+  // segments are processed concurrently, one per thread
+  //=========================================================
+
+  c.seg_cols = roundoff(seg_len * samplerate * pixpersec);
+  if (c.seg_cols < 1)
+    c.seg_cols = 1;
+
+  if (seg_len > 0.0 && c.seg_cols < Xsize)
+  {
+    nseg = (Xsize + c.seg_cols - 1) / c.seg_cols;
+    message("Analysing in %d segments", nseg);
+
+    c.s = s;
+    c.out = out;
+    c.samplecount = samplecount;
+    c.Xsize = Xsize;
+    c.margin = anal_margin(bands, bpo, pixpersec, basefreq);
+    c.bpo = bpo;
+    c.pixpersec = pixpersec;
+    c.basefreq = basefreq;
+    c.max = calloc(nthreads, sizeof(double));
+
+    cost = malloc(nseg * sizeof(double));
+    for (i = 0; i < nseg; i++)
+      cost[i] = 1.0;
+    cost[nseg - 1] = 0.5;		// the last one is usually shorter
+
+    pool_run(nseg, cost, anal_segment, &c, nthreads);
+
+    for (i = 0; i < nthreads; i++)
+      if (c.max[i] > out->max)
+        out->max = c.max[i];
+
+    free(c.max);
+    free(cost);
+  }
+  else
+  {
+    if (keep)			// the analysis works on a copy
     {
-      t = out[bands - ib - 1];
-      out[bands - ib - 1] = blackman_downsampling(out[bands - ib - 1], Mc, Md);
-      free(t);
+      t = buf_alloc(samplecount);
+      memcpy(t, s, samplecount * sizeof(real));
     }
+    else
+      t = s;
+
+    freq = freqarray(basefreq, bands, bpo);
+    t = anal_levels(t, samplecount, out, 0, Xsize, freq, bpo, pixpersec,
+                    basefreq, max_freq(basefreq, bands, bpo), 0, nthreads);
+    free(freq);
+
+    if (keep)
+      buf_free(t);
+    else
+      s = t;
+  }
+
+  return s;
+}
+
+//=====================================================================
+
+// s = the original signal
+// samplecount = the original signal's orginal length
+// max = the largest value of the image, which is left unnormalised
+
+image_t *
+anal
+(
+  real *s, int32_t samplecount, int32_t samplerate, int32_t bands,
+  double bpo, double pixpersec, double basefreq, double *max
+)
+{
+  int32_t Xsize;
+  image_t *out;
+  anal_out_t o;
+
+  Xsize = anal_width(samplecount, pixpersec);
+
+  message("Image size: %d(W)x%d(H)", Xsize, bands);
+  out = image_new(Xsize, bands, IMAGE_REAL);
+
+  o.image = out;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = NULL;
+
+  anal_into(s, samplecount, samplerate, Xsize, bpo, pixpersec, basefreq,
+            &o, 0, threads);
+
+  *max = o.max;
+
+  return out;
+}
+
+//=====================================================================
+
+// analyses the signal s like anal(), straight into an 8-bit image whose
+// levels are those quant_init() gives for the largest value and 'ratio'.
+// A first pass finds the largest value and keeps nothing, the second
+// one quantises every band as soon as it's done, so the only reals
+// held are those of the bands being worked on. s is freed.
+
+image_t *
+anal_u8
+(
+  real *s, int32_t samplecount, int32_t samplerate, int32_t bands,
+  double bpo, double pixpersec, double basefreq, double ratio
+)
+{
+  int32_t Xsize;
+  image_t *out;
+  quant_t q;
+  anal_out_t o;
+
+  Xsize = anal_width(samplecount, pixpersec);
+  message("Image size: %d(W)x%d(H)", Xsize, bands);
+
+  o.image = NULL;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = NULL;
+
+  message("Pass 1: finding the largest value");
+  anal_into(s, samplecount, samplerate, Xsize, bpo, pixpersec, basefreq,
+            &o, 1, threads);
+
+  quant_init(&q, o.max, ratio);
+  out = image_new(Xsize, bands, IMAGE_U8);
+  o.image = out;
+  o.q = &q;
+
+  message("Pass 2: quantising the bands");
+  s = anal_into(s, samplecount, samplerate, Xsize, bpo, pixpersec,
+                basefreq, &o, 0, threads);
+  buf_free(s);
+
+  return out;
+}
+
+//=====================================================================
 
-    out[bands - ib - 1] = realloc(out[bands - ib - 1], *Xsize * sizeof(double));	// Tail chopping
+// what the channel tasks of a multichannel analysis share
+
+typedef struct
+{
+  real **s;			// the signals
+  anal_out_t *out;		// where each one goes
+  int32_t samplecount, samplerate, Xsize;
+  int32_t nthreads;		// for each signal
+  double bpo, pixpersec, basefreq;
+} chan_ctx_t;
+
+//=====================================================================
+
+static void
+anal_channel(void *ctx, int32_t task, int32_t worker)
+{
+  chan_ctx_t *c = (chan_ctx_t *) ctx;
+
+  c->s[task] = anal_into(c->s[task], c->samplecount, c->samplerate,
+                         c->Xsize, c->bpo, c->pixpersec, c->basefreq,
+                         &c->out[task], 0, c->nthreads);
+}
+
+//=====================================================================
+
+// analyses the nch signals of s like anal(), all at once, the threads
+// being shared among them. Every signal gets its own image, or with
+// 'stacked' they all go into the first one, a band tall each and the
+// first signal on top, the other images being NULL. max[ic] is the
+// largest value of signal ic. The signals are overwritten.
+
+image_t **
+anal_channels
+(
+  real **s, int32_t nch, int32_t samplecount, int32_t samplerate,
+  int32_t bands, double bpo, double pixpersec, double basefreq,
+  int32_t stacked, double *max
+)
+{
+  int32_t ic;
+  image_t **out;
+  double *cost;
+  chan_ctx_t c;
+
+  c.Xsize = anal_width(samplecount, pixpersec);
+
+  message("Image size: %d(W)x%d(H)", c.Xsize,
+          stacked ? nch * bands : bands);
+  message("Analysing %d channels", nch);
+
+  out = calloc(nch, sizeof(image_t *));
+  c.out = malloc(nch * sizeof(anal_out_t));
+  cost = malloc(nch * sizeof(double));
+
+  for (ic = 0; ic < nch; ic++)
+  {
+    if (! stacked || ic == 0)
+      out[ic] = image_new(c.Xsize, stacked ? nch * bands : bands,
+                          IMAGE_REAL);
+
+    c.out[ic].image = out[stacked ? 0 : ic];
+    c.out[ic].dst = 0;
+    c.out[ic].y0 = stacked ? ic * bands : 0;
+    c.out[ic].bands = bands;
+    c.out[ic].q = NULL;
+    c.out[ic].put = NULL;
+    cost[ic] = 1.0;
   }
 
-  normi(out, *Xsize, bands, 1.0);
+  // the channels share the threads, and the plans & filter banks of
+  // their common lengths
+
+  c.s = s;
+  c.samplecount = samplecount;
+  c.samplerate = samplerate;
+  c.nthreads = threads / nch > 1 ? threads / nch : 1;
+  c.bpo = bpo;
+  c.pixpersec = pixpersec;
+  c.basefreq = basefreq;
+
+  pool_run(nch, cost, anal_channel, &c, threads);
+
+  for (ic = 0; ic < nch; ic++)
+    max[ic] = c.out[ic].max;
+
+  free(c.out);
+  free(cost);
 
   return out;
 }
 
 //=====================================================================
 
-double *
+// mixes the nch signals of s (n samples each) down to their average, in
+// s[0]
+
+void
+downmix(real **s, int32_t nch, int32_t n)
+{
+  int32_t ic;
+
+  kern.scale(s[0], n, 1.0 / nch);
+
+  for (ic = 1; ic < nch; ic++)
+    kern.add_scaled(s[0], s[ic], n, 1.0 / nch);
+}
+
+//=====================================================================
+
+// turns the left & right signals s[0] and s[1] (n samples each) into
+// their mid (half sum) & side (half difference) signals
+
+void
+mid_side(real **s, int32_t n)
+{
+  kern.mid_side(s[0], s[1], n);
+}
+
+//=====================================================================
+
+// analyses the signal s like anal() but keeps no image: every row is
+// given to put() as soon as its band is done, unscaled, by any of the
+// threads, anal_width() columns long. s is freed.
+
+void
+anal_rows
+(
+  real *s, int32_t samplecount, int32_t bands, double bpo,
+  double pixpersec, double basefreq, row_fn_t put, void *put_ctx
+)
+{
+  int32_t Xsize;
+  double *freq;
+  anal_out_t o;
+
+  Xsize = anal_width(samplecount, pixpersec);
+  message("Image size: %d(W)x%d(H)", Xsize, bands);
+
+  o.image = NULL;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = put;
+  o.put_ctx = put_ctx;
+  o.max = 0.0;
+
+  freq = freqarray(basefreq, bands, bpo);
+  s = anal_levels(s, samplecount, &o, 0, Xsize, freq, bpo, pixpersec,
+                  basefreq, max_freq(basefreq, bands, bpo), 0, threads);
+  free(freq);
+  buf_free(s);
+}
+
+//=====================================================================
+
+// returns the largest value of the rows anal_rows() gives for the signal
+// s, keeping none of them. s is left as it is.
+
+double
+anal_rows_max
+(
+  real *s, int32_t samplecount, int32_t bands, double bpo,
+  double pixpersec, double basefreq
+)
+{
+  double *freq;
+  real *t;
+  anal_out_t o;
+
+  o.image = NULL;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = NULL;
+  o.max = 0.0;
+
+  t = buf_alloc(samplecount);			// the analysis works on a copy
+  memcpy(t, s, samplecount * sizeof(real));
+
+  freq = freqarray(basefreq, bands, bpo);
+  t = anal_levels(t, samplecount, &o, 0, anal_width(samplecount, pixpersec),
+                  freq, bpo, pixpersec, basefreq,
+                  max_freq(basefreq, bands, bpo), 0, threads);
+  free(freq);
+  buf_free(t);
+
+  return o.max;
+}
+
+//=====================================================================
+
+real *
 wsinc_max(int32_t length, double bw)
 {
   int32_t i;
   int32_t bwl;			// integer transition bandwidth
   double tbw;			// double transition bandwidth
-  double *h;			// kernel
+  real *h;			// kernel
   double x;			// position in the antiderivate of the
   				// Blackman function of the sample we're at
   double coef;			// coefficient obtained from the function
 
   tbw = bw * (double) (length - 1);
   bwl = roundup(tbw);
-  h = calloc(length, sizeof(double));
+  h = buf_calloc(length);
 
   for (i = 1; i < length; i++)
     h[i] = 1.0;
@@ -533,24 +1431,29 @@ wsinc_max(int32_t length, double bw)
 // bands = the total count of bands
 // samplecount = the output sound's length
 
-double *
+real *
 synt_sine
 (
-  double **d, int32_t Xsize, int32_t bands, int32_t * samplecount,
-  int32_t samplerate, double basefreq, double pixpersec, double bpo
+  image_t *d, int32_t * samplecount, int32_t samplerate, double basefreq,
+  double pixpersec, double bpo
 )
 {
-  double *s, *freq, *filter, *sband, sine[4], rphase;
-  int32_t i, ib;
+  real *s, *filter, *sband, *sb, *row;
+  double *freq, sine[4], rphase;
+  int32_t i, j, ib, nb, batch, Xsize, bands;
   int32_t Fc, Bc, Mh, Mn, sbsize;
 
   /*
      s = the output sound
-     sband = the band's envelope upsampled and shifted up in frequency
-     sbsize = the length of sband
+     row = the envelope of one band in the image
+     sband = the envelopes of a batch of bands upsampled and shifted up in frequency
+     sb = the envelope of one band within sband
+     sbsize = the length of the envelope of one band
+     batch = the most bands transformed together
+     nb = the number of bands in the current batch
      sine = the random sine look-up table
      ib = the band iterator
-     i = a general purpose iterator
+     i, j = general purpose iterators
      Fc = the index of the band's centre in the frequency domain on the new signal
      Bc = the index of the band's centre in the frequency domain on sband (its imaginary match being sbsize-Bc)
      Mh = the length of the real or imaginary part of the envelope's FFT, DC element included and Nyquist element excluded
@@ -559,16 +1462,26 @@ synt_sine
      rphase = the band's sine's random phase
    */
 
+  Xsize = d->width;
+  bands = d->height;
   freq = freqarray(basefreq, bands, bpo);
-  sbsize = nextsprime(Xsize * 2);		// In Circular mode keep it to
+  sbsize = fft_size(Xsize * 2, FFT_SIZE_REAL);		// In Circular mode keep it to
   						// sbsize = Xsize * 2;
   *samplecount = roundoff(Xsize / pixpersec);
   message("Sound duration: %.3f s", (double) *samplecount / samplerate);
   *samplecount = roundoff(0.5 * sbsize / pixpersec);	// Do not change this
   							// value as it would
   							// stretch envelopes
-  s = calloc(*samplecount, sizeof(double));	// allocate the sound signal
-  sband = malloc(sbsize * sizeof(double));	// allocate the shifted band
+  s = buf_calloc(*samplecount);	// allocate the sound signal
+
+  // all the bands have the same length so they are transformed in batches
+  batch = BATCH_LEN / sbsize;
+  if (batch > MAX_BATCH)
+    batch = MAX_BATCH;
+  if (batch < 1)
+    batch = 1;
+
+  sband = buf_alloc(batch * sbsize);	// allocate the shifted bands
   Bc = roundoff(0.25 * (double) sbsize);
   Mh = (sbsize + 1) >> 1;
   Mn = (*samplecount + 1) >> 1;
@@ -576,74 +1489,91 @@ synt_sine
   // generation of the frequency-domain filter
   filter = wsinc_max(Mh, 1.0 / TRANSITION_BW_SYNT);
 
-  for (ib = 0; ib < bands; ib++)
+  for (ib = 0; ib < bands; ib += nb)
   {
-    memset(sband, 0, sbsize * sizeof(double));	// reset sband
+    nb = bands - ib;
+    if (nb > batch)
+      nb = batch;
+
+    memset(sband, 0, nb * sbsize * sizeof(real));	// reset sband
 
     //===================
     // frequency shifting
     //===================
-    
-    rphase = dblrand() * PI;	// random phase between -pi and +pi
 
-    for (i = 0; i < 4; i++)	// generating the random sine LUT
-      sine[i] = cos(i * 2.0 * PI * 0.25 + rphase);
-
-    for (i = 0; i < Xsize; i++)	// envelope sampling rate * 2 and frequency shifting by 0.25
+    for (j = 0; j < nb; j++)
     {
-      if ((i & 1) == 0)
-      {
-	sband[i << 1] = d[bands - ib - 1][i] * sine[0];
-	sband[(i << 1) + 1] = d[bands - ib - 1][i] * sine[1];
-      }
-      else
+      sb = &sband[j * sbsize];
+      row = image_row(d, bands - ib - j - 1);
+      rphase = dblrand() * PI;	// random phase between -pi and +pi
+
+      for (i = 0; i < 4; i++)	// generating the random sine LUT
+        sine[i] = cos(i * 2.0 * PI * 0.25 + rphase);
+
+      for (i = 0; i < Xsize; i++)	// envelope sampling rate * 2 and frequency shifting by 0.25
       {
-	sband[i << 1] = d[bands - ib - 1][i] * sine[2];
-	sband[(i << 1) + 1] = d[bands - ib - 1][i] * sine[3];
+        if ((i & 1) == 0)
+        {
+	  sb[i << 1] = row[i] * sine[0];
+	  sb[(i << 1) + 1] = row[i] * sine[1];
+        }
+        else
+        {
+	  sb[i << 1] = row[i] * sine[2];
+	  sb[(i << 1) + 1] = row[i] * sine[3];
+        }
       }
     }
 
-    fft(sband, sband, sbsize, 0);		// FFT of the envelope
-    Fc = roundoff(freq[ib] * *samplecount);	// band's centre index
-    						// (envelope's DC element)
+    fft_many(sband, sband, sbsize, nb, 0);	// FFT of the envelopes
+
     //==========
     // write FFT
     //==========
 
-    for (i = 1; i < Mh; i++)
+    for (j = 0; j < nb; j++)
     {
-      // if we're between frequencies 0 and 0.5 of the new signal and that
-      // we're not at Fc
-      if (Fc - Bc + i > 0 && Fc - Bc + i < Mn)
+      sb = &sband[j * sbsize];
+      Fc = roundoff(freq[ib + j] * *samplecount);	// band's centre index
+      						// (envelope's DC element)
+
+      for (i = 1; i < Mh; i++)
       {
-	s[i + Fc - Bc] += sband[i] * filter[i];	// Real part
-	s[*samplecount - (i + Fc - Bc)] += sband[sbsize - i] * filter[i];	// Imaginary part
+        // if we're between frequencies 0 and 0.5 of the new signal and that
+        // we're not at Fc
+        if (Fc - Bc + i > 0 && Fc - Bc + i < Mn)
+        {
+	  s[i + Fc - Bc] += sb[i] * filter[i];	// Real part
+	  s[*samplecount - (i + Fc - Bc)] += sb[sbsize - i] * filter[i];	// Imaginary part
+        }
       }
     }
   }
 
-  fft(s, s, *samplecount, 1);	// IFFT of the final sound
+  fft_threaded(s, s, *samplecount, 1);	// IFFT of the final sound
   *samplecount = roundoff(Xsize / pixpersec);	// chopping tails by ignoring them
-  normi(&s, *samplecount, 1, 1.0);
+  normalise(s, *samplecount, 1.0);
 
   return s;
 }
 
 //=====================================================================
 
-double *
+real *
 synt_noise
 (
-  double **d, int32_t Xsize, int32_t bands, int32_t * samplecount,
-  int32_t samplerate, double basefreq, double pixpersec, double bpo
+  image_t *d, int32_t * samplecount, int32_t samplerate, double basefreq,
+  double pixpersec, double bpo
 )
 {
   int32_t i;			// general purpose iterator
+  int32_t Xsize;		// width of the image
+  int32_t bands;		// height of the image
   int32_t ib;			// bands iterator
-  int32_t il;			// loop iterator
-  double *s;			// final signal
-  double coef;
-  double *noise;		// filtered looped noise
+  int32_t n;			// number of samples processed at once
+  real *s;			// final signal
+  real *w;			// window of the band
+  real *noise;			// filtered looped noise
   double loop_size_sec;		// size of the filter bank loop, in seconds.
   				// Later to be taken from user input
   int32_t loop_size;		// size of the filter bank loop, in samples.
@@ -651,24 +1581,24 @@ synt_noise
   int32_t loop_size_min;	// minimum required size for the filter bank
   				// loop, in samples. Calculated from the
   				// longest windowed sinc's length
-  double *pink_noise;		// original pink noise (in the frequency
+  real *pink_noise;		// original pink noise (in the frequency
                                 // domain)
   double mag, phase;		// parameters for the creation of pink_noise's
   				// samples
-  double *envelope;		// interpolated envelope
-  double *lut;			// Blackman Sqaure look-up table
+  real *envelope;		// interpolated envelope
+  resampler_t *interp;		// interpolation of the envelopes
+  real *wb;			// window of the band, when computed here
 
   double *freq;			// frequency look-up table
   double maxfreq;		// central frequency of the last band
+  bank_t *bank;			// the filters of the bands
   int32_t Fa;			// Fa is the index of the band's start in the
   				// frequency domain
   int32_t Fd;			// Fd is the index of the band's end in the
   				// frequency domain
-  double La;			// La is the log2 of the frequency of Fa
-  double Ld;			// Ld is the log2 of the frequency of Fd
-  double Li;			// Li is the iterative frequency between
-  				// La and Ld defined logarithmically
 
+  Xsize = d->width;
+  bands = d->height;
   loop_size_sec = BANK_LOOP_SIZE;
   freq = freqarray(basefreq, bands, bpo);
 
@@ -683,8 +1613,8 @@ synt_noise
   *samplecount = roundoff(Xsize / pixpersec);
   message("Sound duration: %.3f s", (double) *samplecount / samplerate);
 
-  s = calloc(*samplecount, sizeof(double));		// final signal
-  envelope = calloc(*samplecount, sizeof(double));	// interpolated envelope
+  s = buf_calloc(*samplecount);		// final signal
+  envelope = buf_calloc(*samplecount);	// interpolated envelope
 
   //======================
   // loop size calculation
@@ -706,13 +1636,13 @@ synt_noise
   if (loop_size_min > loop_size)
     loop_size = loop_size_min;
 
-  loop_size = nextsprime(loop_size);	// enlarge the loop_size to the next multiple of short primes in order to make IFFTs faster
+  loop_size = fft_size(loop_size, FFT_SIZE_REAL);	// enlarge the loop_size to a size that makes IFFTs faster
 
   //======================
   // pink noise generation
   //======================
 
-  pink_noise = calloc(loop_size, sizeof(double));
+  pink_noise = buf_calloc(loop_size);
 
   for (i = 1; i < (loop_size + 1) >> 1; i++)
   {
@@ -724,64 +1654,52 @@ synt_noise
     pink_noise[loop_size - i] = mag * sin(phase);	// imaginary part
   }
 
-  noise = malloc(loop_size * sizeof(double));
+  noise = buf_alloc(loop_size);
+  bank = bank_get(loop_size, bands, basefreq, maxfreq, threads);
+  wb = buf_alloc(bank->wmax);
 
-  // Blackman Square look-up table initalisation
-  lut = bmsq_lut(BMSQ_LUT_SIZE);
+  // the envelopes are all interpolated the same way
+  interp = resample_new(Xsize, *samplecount, RESAMPLE_BMSQ);
 
   for (ib = 0; ib < bands; ib++)
   {
-    memset(noise, 0, loop_size * sizeof(double));	// reset filtered noise
+    memset(noise, 0, loop_size * sizeof(real));	// reset filtered noise
 
     //==========
     // filtering
     //==========
 
-    Fa =
-      roundoff(log_pos((double) (ib - 1) / (double) (bands - 1), basefreq, maxfreq) * loop_size);
-    Fd =
-      roundoff(log_pos((double) (ib + 1) / (double) (bands - 1), basefreq, maxfreq) * loop_size);
-    La = log_pos_inv((double) Fa / (double) loop_size, basefreq, maxfreq);
-    Ld = log_pos_inv((double) Fd / (double) loop_size, basefreq, maxfreq);
+    Fa = bank->Fa[ib];
+    Fd = bank->Fd[ib];
+    w = bank_weights(bank, ib, wb);
 
-    // stop reading if we reach the Nyquist frequency
-    if (Fd > loop_size / 2)
-      Fd = loop_size / 2;
-
-    if (Fa < 1)
-      Fa = 1;
-
-    for (i = Fa; i < Fd; i++)
-    {
-      Li = log_pos_inv((double) i / (double) loop_size, basefreq, maxfreq);	// calculation of the logarithmic position
-      Li = (Li - La) / (Ld - La);
-      coef = 0.5 - 0.5 * cos(2.0 * PI * Li);	// Hann function
-      noise[i + 1] = pink_noise[i + 1] * coef;
-      noise[loop_size - 1 - i] = pink_noise[loop_size - 1 - i] * coef;
-    }
+    // real parts from Fa + 1 upwards, imaginary parts from
+    // loop_size - Fa - 1 downwards
+    kern.mul(&noise[Fa + 1], &pink_noise[Fa + 1], w, Fd - Fa);
+    kern.mul_rev(&noise[loop_size - Fd], &pink_noise[loop_size - Fd], w, Fd - Fa);
 
     fft(noise, noise, loop_size, 1);		// IFFT of the filtered noise
-    memset(envelope, 0, *samplecount * sizeof(double));
 
     // interpolation of the envelope
-    blackman_square_interpolation
-    (
-      d[bands - ib - 1], envelope, Xsize, *samplecount, lut, BMSQ_LUT_SIZE
-    );
+    resample_run(interp, image_row(d, bands - ib - 1), envelope);
 
-    il = 0;
-    for (i = 0; i < *samplecount; i++)
+    // modulation, the noise loop being repeated as many times as needed
+    for (i = 0; i < *samplecount; i += n)
     {
-      s[i] += envelope[i] * noise[il];		// modulation
-      il++;					// increment loop iterator
+      n = *samplecount - i;
+      if (n > loop_size)
+        n = loop_size;
 
-      // if the array iterator has reached the end of the array, it's reset
-      if (il == loop_size)
-	il = 0;
+      kern.mul_acc(&s[i], &envelope[i], noise, n);
     }
   }
 
-  normi(&s, *samplecount, 1, 1.0);
+  buf_free(wb);
+  buf_free(envelope);
+  resample_free(interp);
+  bank_release(bank);
+
+  normalise(s, *samplecount, 1.0);
 
   return s;
 }
@@ -798,11 +1716,330 @@ synt_noise
 // ratio is used for the reverse transformation
 
 void
-brightness_control(double **image, int32_t width, int32_t height, double ratio)	// Almost like a gamma correction, but uses a different formula
+brightness_control(image_t *image, double ratio)	// Almost like a gamma correction, but uses a different formula
 {
   int32_t ix, iy;
+  real *row;
+
+  for (iy = 0; iy < image->height; iy++)
+  {
+    row = image_row(image, iy);
+
+    for (ix = 0; ix < image->width; ix++)
+      row[ix] = pow(row[ix], ratio);
+  }
+}
+
+//=====================================================================
+
+// The precision check runs the analysis and both syntheses on a test
+// sound and compares their outputs with those of the double precision
+// build, which saves them to a reference file when it runs the check.
+// The syntheses work on the 8-bit image of the double precision build,
+// like they would on its BMP file, and the transforms have the sizes it
+// chose, so every stage gets the same input in both builds and only the
+// precision differs.
+
+enum
+{
+  PC_VERSION, PC_LEN, PC_BANDS, PC_WIDTH, PC_SINE, PC_NOISE,
+  PC_LOGBASE, PC_MULTIRATE, PC_DECIM,
+  PC_COUNT
+};
+
+typedef struct
+{
+  double head[PC_COUNT];	// what the outputs are made of
+  double weights[8];		// & the radix weights of the FFT sizes
+  double *img;			// the image normalised to 1, row by row
+  uint8_t *lev;			// & its 8-bit levels
+  double *snd[2];		// the sine & noise syntheses
+} check_t;
+
+//=====================================================================
+
+static void
+check_free(check_t *c)
+{
+  free(c->img);
+  free(c->lev);
+  free(c->snd[0]);
+  free(c->snd[1]);
+}
+
+//=====================================================================
+
+// reads the reference file 'name' into c, returns 0 if it is missing or
+// was made with other settings than 'head'
+
+static int32_t
+check_read(char *name, check_t *c, double *head)
+{
+  int32_t ok, n;
+  FILE *f;
+
+  memset(c, 0, sizeof(check_t));
+  f = fopen(name, "rb");
+  if (f == NULL)
+    return 0;
+
+  ok = fread(c->head, sizeof(double), PC_COUNT, f) == PC_COUNT &&
+       fread(c->weights, sizeof(double), 8, f) == 8 &&
+       memcmp(c->head, head, PC_SINE * sizeof(double)) == 0 &&
+       memcmp(&c->head[PC_LOGBASE], &head[PC_LOGBASE],
+              (PC_COUNT - PC_LOGBASE) * sizeof(double)) == 0;
+
+  if (ok)
+  {
+    n = (int32_t) (c->head[PC_BANDS] * c->head[PC_WIDTH]);
+    c->img = malloc(n * sizeof(double));
+    c->lev = malloc(n);
+    c->snd[0] = malloc((size_t) c->head[PC_SINE] * sizeof(double));
+    c->snd[1] = malloc((size_t) c->head[PC_NOISE] * sizeof(double));
+
+    ok = fread(c->img, sizeof(double), n, f) == n &&
+         fread(c->lev, 1, n, f) == n &&
+         fread(c->snd[0], sizeof(double), c->head[PC_SINE], f) ==
+           c->head[PC_SINE] &&
+         fread(c->snd[1], sizeof(double), c->head[PC_NOISE], f) ==
+           c->head[PC_NOISE];
+  }
+
+  fclose(f);
+  if (! ok)
+    check_free(c);
+
+  return ok;
+}
+
+//=====================================================================
+
+// writes c to the reference file 'name', returns 0 if it can't be
+// created
+
+static int32_t
+check_write(char *name, check_t *c)
+{
+  int32_t n;
+  FILE *f;
+
+  f = fopen(name, "wb");
+  if (f == NULL)
+    return 0;
+
+  n = (int32_t) (c->head[PC_BANDS] * c->head[PC_WIDTH]);
+  fwrite(c->head, sizeof(double), PC_COUNT, f);
+  fwrite(c->weights, sizeof(double), 8, f);
+  fwrite(c->img, sizeof(double), n, f);
+  fwrite(c->lev, 1, n, f);
+  fwrite(c->snd[0], sizeof(double), c->head[PC_SINE], f);
+  fwrite(c->snd[1], sizeof(double), c->head[PC_NOISE], f);
+  fclose(f);
+
+  return 1;
+}
+
+//=====================================================================
+
+// runs the analysis of the test sound into c, and both syntheses of the
+// 8-bit image lev, or of the image of the analysis if lev is NULL
+
+static void
+check_run(check_t *c, uint8_t *lev)
+{
+  int32_t i, ix, iy, k, n, bands, Xsize;
+  uint32_t seed;
+  real *s, *row;
+  double bpo, pixpersec, basefreq, maxfreq, f, ph;
+  image_t *img;
+  quant_t q;
+  anal_out_t o;
+
+  // a chirp over the whole range in a little noise, the noise from a
+  // local generator to leave the sequence of rand() untouched
+
+  basefreq = 27.5 / CHECK_RATE;
+  maxfreq = 16000.0 / CHECK_RATE;
+  bands = CHECK_BANDS;
+  bpo = logbase == 1.0 ? maxfreq : (bands - 1) / log_b(maxfreq / basefreq);
+  pixpersec = 100.0 / CHECK_RATE;
+  Xsize = anal_width(CHECK_LEN, pixpersec);
+
+  s = buf_alloc(CHECK_LEN);
+  seed = 1;
+  ph = 0.0;
+
+  for (i = 0; i < CHECK_LEN; i++)
+  {
+    f = basefreq * pow(maxfreq / basefreq, (double) i / CHECK_LEN);
+    ph += 2.0 * PI * f;
+    seed = seed * 1103515245 + 12345;
+    s[i] = 0.5 * sin(ph) + 0.05 * ((double) (seed >> 8) / 8388608.0 - 1.0);
+  }
+
+  img = image_new(Xsize, bands, IMAGE_REAL);
+  o.image = img;
+  o.dst = o.y0 = 0;
+  o.bands = bands;
+  o.q = NULL;
+  o.put = NULL;
+
+  anal_into(s, CHECK_LEN, CHECK_RATE, Xsize, bpo, pixpersec, basefreq, &o,
+            1, threads);
+  buf_free(s);
+
+  c->img = malloc(bands * Xsize * sizeof(double));
+  c->lev = malloc(bands * Xsize);
+  quant_init(&q, o.max, 1.0);
+
+  for (iy = 0; iy < bands; iy++)
+  {
+    row = image_row(img, iy);
+    quant_row(&q, &c->lev[iy * Xsize], row, Xsize);
+    for (ix = 0; ix < Xsize; ix++)
+      c->img[iy * Xsize + ix] = row[ix] / o.max;
+  }
+
+  // the syntheses, from the same random phases
+
+  if (lev == NULL)
+    lev = c->lev;
+
+  for (iy = 0; iy < bands; iy++)
+  {
+    row = image_row(img, iy);
+    for (ix = 0; ix < Xsize; ix++)
+      row[ix] = lev[iy * Xsize + ix] / 255.0;
+  }
+
+  for (k = 0; k < 2; k++)
+  {
+    n = CHECK_LEN;
+    srand(1);
+    if (k == 0)
+      s = synt_sine(img, &n, CHECK_RATE, basefreq, pixpersec, bpo);
+    else
+      s = synt_noise(img, &n, CHECK_RATE, basefreq, pixpersec, bpo);
+
+    c->snd[k] = malloc(n * sizeof(double));
+    for (i = 0; i < n; i++)
+      c->snd[k][i] = s[i];
+
+    c->head[PC_SINE + k] = n;
+    buf_free(s);
+  }
+
+  image_free(img);
+}
+
+//=====================================================================
+
+// reports how the n samples of a differ from those of b: at the 8-bit
+// levels la and lb of the image if they are given, else at the 16-bit
+// levels of a WAV file
+
+static void
+check_report(char *what, double *a, double *b, uint8_t *la, uint8_t *lb,
+             int32_t n)
+{
+  int32_t i, d, ndiff, peak;
+  double err;
+
+  ndiff = peak = 0;
+  err = 0.0;
+
+  for (i = 0; i < n; i++)
+  {
+    if (la != NULL)
+      d = abs(la[i] - lb[i]);
+    else
+      d = abs((int32_t) roundoff(a[i] * 32768.0) -
+              (int32_t) roundoff(b[i] * 32768.0));
+
+    err += (a[i] - b[i]) * (a[i] - b[i]);
+    if (d != 0)
+      ndiff++;
+    if (d > peak)
+      peak = d;
+  }
+
+  if (err == 0.0)
+    message("  %-16s the same", what);
+  else
+    message("  %-16s %5.2f%% of the %d-bit levels differ, by at most %d "
+            "(%.1f dB RMS)", what, 100.0 * ndiff / n, la != NULL ? 8 : 16,
+            peak, 10.0 * log10(err / n));
+}
+
+//=====================================================================
+
+// measures what the single precision build (ASPERES_FLOAT) loses through
+// the analysis and both syntheses against the reference file 'name' of
+// the double precision build, in the levels of the 8-bit image and of
+// the 16-bit sound they write. The double precision build makes the
+// reference instead.
+
+void
+precision_check(char *name)
+{
+  int32_t was_quiet, n;
+  double head[PC_COUNT];
+  check_t ref, cur;
+
+  memset(&cur, 0, sizeof(check_t));
+  head[PC_VERSION] = CHECK_VERSION;
+  head[PC_LEN] = CHECK_LEN;
+  head[PC_BANDS] = CHECK_BANDS;
+  head[PC_WIDTH] = anal_width(CHECK_LEN, 100.0 / CHECK_RATE);
+  head[PC_SINE] = head[PC_NOISE] = 0.0;
+  head[PC_LOGBASE] = logbase;
+  head[PC_MULTIRATE] = multirate;
+  head[PC_DECIM] = freq_decim;
+  memcpy(cur.head, head, sizeof(head));
+
+  was_quiet = quiet;			// the runs themselves say nothing
+
+  if (sizeof(real) == sizeof(double))
+  {
+    fft_size_weights(cur.weights, 0);
+    quiet = 1;
+    check_run(&cur, NULL);
+    quiet = was_quiet;
+
+    if (check_write(name, &cur))
+      message("Precision reference saved to '%s', for '-m bench' of the "
+              "single precision build", name);
+
+    check_free(&cur);
+    return;
+  }
+
+  if (! check_read(name, &ref, head))
+  {
+    message("No precision reference in '%s' made with these settings, run "
+            "'-m bench' of the double precision build first", name);
+    return;
+  }
+
+  fft_size_weights(cur.weights, 0);
+  fft_size_weights(ref.weights, 1);
+  quiet = 1;
+  check_run(&cur, ref.lev);
+  quiet = was_quiet;
+  fft_size_weights(cur.weights, 1);
+
+  message("Single precision against the double precision reference:");
+  n = (int32_t) (head[PC_BANDS] * head[PC_WIDTH]);
+  check_report("analysis", cur.img, ref.img, cur.lev, ref.lev, n);
+
+  n = cur.head[PC_SINE] < ref.head[PC_SINE] ? cur.head[PC_SINE] :
+                                               ref.head[PC_SINE];
+  check_report("sine synthesis", cur.snd[0], ref.snd[0], NULL, NULL, n);
+
+  n = cur.head[PC_NOISE] < ref.head[PC_NOISE] ? cur.head[PC_NOISE] :
+                                                 ref.head[PC_NOISE];
+  check_report("noise synthesis", cur.snd[1], ref.snd[1], NULL, NULL, n);
 
-  for (iy = 0; iy < width; iy++)
-    for (ix = 0; ix < height; ix++)
-      image[iy][ix] = pow(image[iy][ix], ratio);
+  check_free(&ref);
+  check_free(&cur);
 }
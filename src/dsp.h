@@ -15,26 +15,56 @@
 #ifndef H_DSP
 #define H_DSP
 
-extern void fft(double *in, double *out, int32_t N, uint8_t method);
-extern void normi(double **s, int32_t xs, int32_t ys, double ratio);
+// gets row iy of the image, of the image's width, as soon as its band
+// is done
+
+typedef void (*row_fn_t)(void *ctx, int32_t iy, real *row);
+
+extern double log_pos(double x, double min, double max);
+extern double log_pos_inv(double x, double min, double max);
 extern double *freqarray(double basefreq, int32_t bands,
 			 double bandsperoctave);
-extern double *blackman_downsampling(double *in, int32_t Mi, int32_t Mo);
-extern double *bmsq_lut(int32_t size);
-extern void blackman_square_interpolation(double *in, double *out,
-					  int32_t Mi, int32_t Mo,
-					  double *lut, int32_t lut_size);
-extern double **anal(double *s, int32_t samplecount, int32_t samplerate,
-		     int32_t * Xsize, int32_t bands, double bpo,
-		     double pixpersec, double basefreq);
-extern double *wsinc_max(int32_t length, double bw);
-extern double *synt_sine(double **d, int32_t Xsize, int32_t bands,
-			 int32_t * samplecount, int32_t samplerate,
-			 double basefreq, double pixpersec, double bpo);
-extern double *synt_noise(double **d, int32_t Xsize, int32_t bands,
-			  int32_t * samplecount, int32_t samplerate,
-			  double basefreq, double pixpersec, double bpo);
-extern void brightness_control(double **image, int32_t width, int32_t height,
-			       double ratio);
+extern real *halfband_taps(int32_t * ntaps);
+extern int32_t pyramid_level(double f, double pixpersec);
+extern int32_t anal_width(int32_t samplecount, double pixpersec);
+extern int32_t anal_margin(int32_t bands, double bpo, double pixpersec,
+			   double basefreq);
+extern int32_t anal_span(int32_t x0, int32_t x1, int32_t margin,
+			 int32_t samplecount, double pixpersec,
+			 int32_t * a, int32_t * b);
+extern double anal_block(real *s, int32_t first, int32_t samplecount,
+			 int32_t x0, int32_t x1, int32_t margin,
+			 image_t * out, int32_t dst, double bpo,
+			 double pixpersec, double basefreq);
+extern image_t *anal_region(real *s, int32_t first, int32_t samplecount,
+			    int32_t x0, int32_t x1, int32_t bands,
+			    double bpo, double pixpersec, double basefreq,
+			    double *max);
+extern image_t *anal(real *s, int32_t samplecount, int32_t samplerate,
+		     int32_t bands, double bpo, double pixpersec,
+		     double basefreq, double *max);
+extern image_t *anal_u8(real *s, int32_t samplecount, int32_t samplerate,
+			int32_t bands, double bpo, double pixpersec,
+			double basefreq, double ratio);
+extern image_t **anal_channels(real **s, int32_t nch, int32_t samplecount,
+			       int32_t samplerate, int32_t bands, double bpo,
+			       double pixpersec, double basefreq,
+			       int32_t stacked, double *max);
+extern void downmix(real **s, int32_t nch, int32_t n);
+extern void mid_side(real **s, int32_t n);
+extern void anal_rows(real *s, int32_t samplecount, int32_t bands,
+		      double bpo, double pixpersec, double basefreq,
+		      row_fn_t put, void *put_ctx);
+extern double anal_rows_max(real *s, int32_t samplecount, int32_t bands,
+			    double bpo, double pixpersec, double basefreq);
+extern real *wsinc_max(int32_t length, double bw);
+extern real *synt_sine(image_t * d, int32_t * samplecount,
+			 int32_t samplerate, double basefreq,
+			 double pixpersec, double bpo);
+extern real *synt_noise(image_t * d, int32_t * samplecount,
+			  int32_t samplerate, double basefreq,
+			  double pixpersec, double bpo);
+extern void brightness_control(image_t * image, double ratio);
+extern void precision_check(char *name);
 
 #endif
@@ -0,0 +1,693 @@
+/*
+  fft.c - FFT front end: plan cache, backends & transform sizes
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "fft.h"
+#include "fft_backend.h"
+#include "pool.h"
+
+#define PLAN_CACHE_STEP		32	// growth step of the plan cache
+
+
+#define SIZE_LIMIT		(1 << 30)	// largest size in the size table
+#define CAL_SIZE		8192	// most points of a calibration transform
+#define CAL_TIME		20	// least time spent timing a size, in ms
+#define BENCH_TIME		50	// least time spent timing a benchmark size
+
+// the available backends, the first one being the default
+
+static fft_backend_t *backends[] =
+{
+#ifndef ASPERES_NO_FFTW
+  &fftw_backend,
+#endif
+  &builtin_backend,
+  NULL
+};
+
+static fft_backend_t *backend = NULL;
+
+// A plan can only be re-executed on other arrays if they have the same
+// alignment and the same in-place/out-of-place layout as the arrays it
+// was created for, so these are part of the key. The same transform may
+// also be planned for one or several threads, or for a batch of several
+// contiguous arrays.
+
+typedef struct
+{
+  int32_t n;			// transform size
+  uint8_t method;		// 0 = DFT  1 = IDFT  2 = DHT  3/4 = complex
+  uint8_t inplace;		// 1 if in == out
+  int32_t align_in;		// misalignment of the input array
+  int32_t align_out;		// misalignment of the output array
+  int32_t nthreads;		// number of threads the plan uses
+  int32_t howmany;		// number of transforms in the batch
+  void *plan;
+} plan_entry_t;
+
+static plan_entry_t *plans = NULL;
+static int32_t plan_count = 0;
+static int32_t plan_max = 0;
+static mutex_t plan_lock;	// transforms may be asked for by several
+				// threads, but planning is not thread safe
+static mutex_t size_lock;	// guards the loading of the size table
+
+static int32_t fft_threads = 1;
+static int32_t fft_effort = FFT_ESTIMATE;
+
+// The transform sizes are chosen among the numbers made of the primes
+// 2, 3, 5 and 7. The cost of a size N = 2^a * 3^b * 5^c * 7^d is modelled
+// as N * (a*w2 + b*w3 + c*w5 + d*w7), the weights being the time per point
+// of one pass of each radix, measured once for real and complex transforms.
+
+static int32_t radix[4] = { 2, 3, 5, 7 };
+static int32_t *sizes = NULL;
+static int32_t size_count = 0;
+static double cost_weight[2][4];
+static int32_t costs_known = 0;
+static char *cost_name = NULL;
+
+//=====================================================================
+
+// returns the number of the backend called 'name', or -1 if this build
+// doesn't have it
+
+int32_t
+fft_find_backend(char *name)
+{
+  int32_t i;
+
+  for (i = 0; backends[i] != NULL; i++)
+    if (strcmp(name, backends[i]->name) == 0)
+      return i;
+
+  return -1;
+}
+
+//=====================================================================
+
+// selects the backend, sets the planning effort and the number of
+// threads used by the large transforms, and loads previously saved
+// wisdom (if any). The size costs are only loaded (or measured) when a
+// size is first asked for.
+
+void
+fft_init
+(
+  char *wisdom_file, char *cost_file, int32_t effort, int32_t nthreads,
+  int32_t backend_num
+)
+{
+  costs_known = 0;
+  cost_name = NULL;
+  if (cost_file != NULL && cost_file[0] != 0)
+    cost_name = cost_file;
+
+  mutex_init(&plan_lock);
+  mutex_init(&size_lock);
+
+  fft_effort = effort;
+  backend = backends[backend_num];
+  fft_threads = backend->init(wisdom_file, effort, nthreads);
+
+  message("FFT backend: %s", backend->name);
+}
+
+//=====================================================================
+
+// releases all cached plans
+
+static void
+clear_plans(void)
+{
+  int32_t i;
+
+  for (i = 0; i < plan_count; i++)
+    backend->destroy(plans[i].plan);
+
+  free(plans);
+  plans = NULL;
+  plan_count = plan_max = 0;
+}
+
+//=====================================================================
+
+// releases all cached plans and lets the backend save its wisdom
+
+void
+fft_cleanup(void)
+{
+  clear_plans();
+
+  free(sizes);
+  sizes = NULL;
+  size_count = 0;
+
+  backend->cleanup();
+  mutex_destroy(&plan_lock);
+  mutex_destroy(&size_lock);
+}
+
+//=====================================================================
+
+// returns the cached plan matching the arrays, creating it if needed
+
+static void *
+get_plan
+(
+  real *in, real *out, int32_t N, int32_t howmany, uint8_t method,
+  int32_t nthreads
+)
+{
+  int32_t i, align_in, align_out;
+  uint8_t inplace;
+  plan_entry_t *e;
+  void *plan;
+
+  inplace = (in == out);
+  align_in = ALIGNMENT_OF(in);
+  align_out = ALIGNMENT_OF(out);
+
+  mutex_lock(&plan_lock);
+
+  for (i = 0; i < plan_count; i++)
+  {
+    e = &plans[i];
+    if (e->n == N && e->method == method && e->inplace == inplace &&
+        e->align_in == align_in && e->align_out == align_out &&
+        e->nthreads == nthreads && e->howmany == howmany)
+    {
+      plan = e->plan;
+      mutex_unlock(&plan_lock);
+      return plan;
+    }
+  }
+
+  if (plan_count == plan_max)
+  {
+    plan_max += PLAN_CACHE_STEP;
+    plans = realloc(plans, plan_max * sizeof(plan_entry_t));
+  }
+
+  e = &plans[plan_count++];
+  e->n = N;
+  e->method = method;
+  e->inplace = inplace;
+  e->align_in = align_in;
+  e->align_out = align_out;
+  e->nthreads = nthreads;
+  e->howmany = howmany;
+  plan = e->plan = backend->plan(in, out, N, howmany, method, nthreads);
+
+  mutex_unlock(&plan_lock);
+
+  return plan;
+}
+
+//=====================================================================
+
+// performs a Fast Fourier Transform
+// method: 0 = DFT  1 = IDFT  2 = DHT
+// plans are cached for the whole run and re-executed on new arrays
+
+void
+fft(real *in, real *out, int32_t N, uint8_t method)
+{
+  backend->execute(get_plan(in, out, N, 1, method, 1), in, out);
+}
+
+//=====================================================================
+
+// performs 'howmany' transforms of size N on arrays stored one after
+// the other with a single plan, which lets the backend vectorise across
+// them
+
+void
+fft_many(real *in, real *out, int32_t N, int32_t howmany, uint8_t method)
+{
+  backend->execute(get_plan(in, out, N, howmany, method, 1), in, out);
+}
+
+//=====================================================================
+
+// same as fft() but spread over the threads set by fft_init(), meant
+// for the few transforms of the whole signal
+
+void
+fft_threaded(real *in, real *out, int32_t N, uint8_t method)
+{
+  backend->execute(get_plan(in, out, N, 1, method, fft_threads), in, out);
+}
+
+//=====================================================================
+
+// performs a complex Fast Fourier Transform on N interleaved
+// (real, imaginary) pairs
+// method: 0 = DFT  1 = IDFT
+
+void
+fft_complex(real *in, real *out, int32_t N, uint8_t method)
+{
+  fft_complex_many(in, out, N, 1, method);
+}
+
+//=====================================================================
+
+// batched version of fft_complex(), the arrays hold N * howmany pairs
+
+void
+fft_complex_many
+(
+  real *in, real *out, int32_t N, int32_t howmany, uint8_t method
+)
+{
+  void *p;
+
+  p = get_plan(in, out, N, howmany, method == 0 ? CPLX_FWD : CPLX_BWD, 1);
+  backend->execute(p, in, out);
+}
+
+//=====================================================================
+
+static int
+compare_sizes(const void *a, const void *b)
+{
+  return *(const int32_t *) a - *(const int32_t *) b;
+}
+
+//=====================================================================
+
+// builds the sorted table of all the sizes up to SIZE_LIMIT made of the
+// primes 2, 3, 5 and 7
+
+static void
+make_size_table(void)
+{
+  int64_t n2, n3, n5, n7;
+  int32_t max;
+
+  max = 0;
+  for (n2 = 1; n2 <= SIZE_LIMIT; n2 *= 2)
+    for (n3 = n2; n3 <= SIZE_LIMIT; n3 *= 3)
+      for (n5 = n3; n5 <= SIZE_LIMIT; n5 *= 5)
+        for (n7 = n5; n7 <= SIZE_LIMIT; n7 *= 7)
+        {
+          if (size_count == max)
+          {
+            max += 1024;
+            sizes = realloc(sizes, max * sizeof(int32_t));
+          }
+          sizes[size_count++] = (int32_t) n7;
+        }
+
+  qsort(sizes, size_count, sizeof(int32_t), compare_sizes);
+}
+
+//=====================================================================
+
+// returns the time of one transform of size N in ms
+
+static double
+time_transform(real *buf, int32_t N, int32_t kind, int32_t min_time)
+{
+  int32_t i, reps, t;
+
+  reps = 1;
+  while (1)
+  {
+    memset(buf, 0, N * 2 * sizeof(real));
+
+    t = gettime();
+    for (i = 0; i < reps; i++)
+    {
+      if (kind == FFT_SIZE_COMPLEX)
+        fft_complex(buf, buf, N, 0);
+      else
+        fft(buf, buf, N, 0);
+    }
+    t = gettime() - t;
+
+    if (t >= min_time)
+      return (double) t / reps;
+
+    reps *= 2;
+  }
+}
+
+//=====================================================================
+
+// measures the weight of every radix for both kinds of transform
+
+static void
+calibrate_costs(void)
+{
+  int32_t i, k, e, n;
+  real *buf;
+
+  message("Calibrating the FFT size costs...");
+
+  buf = buf_alloc(CAL_SIZE * 2);
+
+  for (k = 0; k < 2; k++)
+    for (i = 0; i < 4; i++)
+    {
+      // largest power of the radix within CAL_SIZE
+      for (n = radix[i], e = 1; n * radix[i] <= CAL_SIZE; n *= radix[i])
+        e++;
+
+      // the first call includes the planning, so it is not timed
+      memset(buf, 0, n * 2 * sizeof(real));
+      if (k == FFT_SIZE_COMPLEX)
+        fft_complex(buf, buf, n, 0);
+      else
+        fft(buf, buf, n, 0);
+
+      cost_weight[k][i] = time_transform(buf, n, k, CAL_TIME) / ((double) n * e);
+    }
+
+  buf_free(buf);
+}
+
+//=====================================================================
+
+// loads the radix weights of the current backend from the cost file, or
+// measures them and adds them to the file if they are missing. Every
+// line holds the backend name, the kind of transform and the 4 weights,
+// so the lines of the other backends are kept when the file is rewritten.
+
+static void
+load_costs(void)
+{
+  int32_t k, found, len, kept_len;
+  char line[256], name[16], kind[16], *kept;
+  double w[4];
+  FILE *f;
+
+  found = 0;
+  kept = NULL;
+  kept_len = 0;
+
+  if (cost_name != NULL && (f = fopen(cost_name, "r")) != NULL)
+  {
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+      if (sscanf(line, "%15s %15s %lf %lf %lf %lf",
+                 name, kind, &w[0], &w[1], &w[2], &w[3]) != 6 ||
+          w[0] <= 0.0 || w[1] <= 0.0 || w[2] <= 0.0 || w[3] <= 0.0)
+        continue;
+
+      if (strcmp(kind, "real") == 0)
+        k = FFT_SIZE_REAL;
+      else if (strcmp(kind, "complex") == 0)
+        k = FFT_SIZE_COMPLEX;
+      else
+        continue;
+
+      if (strcmp(name, backend->name) == 0)
+      {
+        memcpy(cost_weight[k], w, sizeof(w));
+        found |= 1 << k;
+      }
+      else
+      {
+        len = strlen(line);
+        kept = realloc(kept, kept_len + len + 1);
+        memcpy(kept + kept_len, line, len + 1);
+        kept_len += len;
+      }
+    }
+
+    fclose(f);
+  }
+
+  costs_known = 1;
+  if (found == 3)
+  {
+    free(kept);
+    return;
+  }
+
+  calibrate_costs();
+
+  if (cost_name == NULL)
+  {
+    free(kept);
+    return;
+  }
+
+  f = fopen(cost_name, "w");
+  if (f == NULL)
+  {
+    message("Warning: cannot save FFT costs to '%s'.", cost_name);
+    free(kept);
+    return;
+  }
+
+  if (kept != NULL)
+    fputs(kept, f);
+
+  for (k = 0; k < 2; k++)
+    fprintf(f, "%s %s %g %g %g %g\n", backend->name,
+            k == FFT_SIZE_COMPLEX ? "complex" : "real",
+            cost_weight[k][0], cost_weight[k][1], cost_weight[k][2],
+            cost_weight[k][3]);
+
+  fclose(f);
+  free(kept);
+}
+
+//=====================================================================
+
+// returns the modelled cost of a transform of size N
+
+static double
+size_cost(int32_t N, int32_t kind)
+{
+  int32_t i, m;
+  double passes;
+
+  passes = 0.0;
+  m = N;
+  for (i = 0; i < 4; i++)
+    while (m % radix[i] == 0)
+    {
+      m /= radix[i];
+      passes += cost_weight[kind][i];
+    }
+
+  return (double) N * passes;
+}
+
+//=====================================================================
+
+// returns the transform size not smaller than n that is the cheapest
+// to compute. kind: FFT_SIZE_REAL or FFT_SIZE_COMPLEX
+// The next power of 2 is always a candidate, so no larger size is tried.
+
+int32_t
+fft_size(int32_t n, int32_t kind)
+{
+  int32_t lo, hi, mid, pow2, best;
+  double cost, best_cost;
+
+  mutex_lock(&size_lock);
+
+  if (sizes == NULL)
+    make_size_table();
+
+  if (! costs_known)
+    load_costs();
+
+  mutex_unlock(&size_lock);
+
+  if (n <= 1 || n > sizes[size_count - 1])
+    return n;
+
+  lo = 0;
+  hi = size_count - 1;		// first size >= n
+  while (lo < hi)
+  {
+    mid = (lo + hi) / 2;
+    if (sizes[mid] < n)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  for (pow2 = 1; pow2 < n; pow2 *= 2)
+    ;
+
+  best = sizes[lo];
+  best_cost = size_cost(best, kind);
+  for (; lo < size_count && sizes[lo] <= pow2; lo++)
+  {
+    cost = size_cost(sizes[lo], kind);
+    if (cost < best_cost)
+    {
+      best = sizes[lo];
+      best_cost = cost;
+    }
+  }
+
+  return best;
+}
+
+//=====================================================================
+
+// copies the radix weights of the transform sizes (2 kinds by 4 radices)
+// to w, or from w if 'set', so that another run picks the same sizes
+
+void
+fft_size_weights(double *w, int32_t set)
+{
+  mutex_lock(&size_lock);
+
+  if (! costs_known)
+    load_costs();
+
+  if (set)
+    memcpy(cost_weight, w, sizeof(cost_weight));
+  else
+    memcpy(w, cost_weight, sizeof(cost_weight));
+
+  mutex_unlock(&size_lock);
+}
+
+//=====================================================================
+
+// times every backend on a set of sizes of each class (powers of 2,
+// 2^a 3^b, other 5/7-smooth sizes and primes), small to large, for both
+// kinds of transform, and reports which backend is fastest per class.
+// The backends other than the current one are planned without wisdom.
+
+static int32_t bench_sizes[4][3] =
+{
+  { 1024, 65536, 1048576 },
+  { 1536, 62208, 995328 },
+  { 1000, 50000, 1003520 },
+  { 1021, 65537, 1000003 }
+};
+
+static char *bench_class[4] =
+{
+  "powers of 2", "2^a 3^b", "5/7-smooth", "primes"
+};
+
+void
+fft_bench(void)
+{
+  int32_t b, c, i, k, nb, best, max;
+  double t[8][2][4][3], score[8], tmin;
+  char line[256];
+  fft_backend_t *current;
+  real *buf;
+
+  current = backend;
+  for (nb = 0; backends[nb] != NULL && nb < 8; nb++)
+    ;
+
+  max = 0;
+  for (c = 0; c < 4; c++)
+    for (i = 0; i < 3; i++)
+      if (bench_sizes[c][i] > max)
+        max = bench_sizes[c][i];
+
+  buf = buf_alloc(max * 2);
+
+  for (b = 0; b < nb; b++)
+  {
+    clear_plans();
+    backend = backends[b];
+    if (backend != current)
+      backend->init(NULL, fft_effort, 1);
+
+    message("Timing the %s backend...", backend->name);
+    for (k = 0; k < 2; k++)
+      for (c = 0; c < 4; c++)
+        for (i = 0; i < 3; i++)
+        {
+          // the first call includes the planning, so it is not timed
+          memset(buf, 0, bench_sizes[c][i] * 2 * sizeof(real));
+          if (k == FFT_SIZE_COMPLEX)
+            fft_complex(buf, buf, bench_sizes[c][i], 0);
+          else
+            fft(buf, buf, bench_sizes[c][i], 0);
+
+          t[b][k][c][i] = time_transform(buf, bench_sizes[c][i], k,
+                                         BENCH_TIME);
+        }
+
+    clear_plans();
+    if (backend != current)
+      backend->cleanup();
+  }
+
+  backend = current;
+  buf_free(buf);
+
+  // time per transform in microseconds
+
+  sprintf(line, "%-8s %8s", "kind", "size");
+  for (b = 0; b < nb; b++)
+    sprintf(line + strlen(line), " %12s", backends[b]->name);
+  message("\n%s", line);
+
+  for (k = 0; k < 2; k++)
+    for (c = 0; c < 4; c++)
+      for (i = 0; i < 3; i++)
+      {
+        sprintf(line, "%-8s %8d", k == FFT_SIZE_COMPLEX ? "complex" : "real",
+                bench_sizes[c][i]);
+        for (b = 0; b < nb; b++)
+          sprintf(line + strlen(line), " %12.1f", t[b][k][c][i] * 1000.0);
+        message("%s", line);
+      }
+
+  // the winner of a class has the lowest sum of times relative to the
+  // fastest backend, so that the large sizes don't hide the small ones
+
+  message("");
+  for (k = 0; k < 2; k++)
+    for (c = 0; c < 4; c++)
+    {
+      for (b = 0; b < nb; b++)
+        score[b] = 0.0;
+
+      for (i = 0; i < 3; i++)
+      {
+        tmin = t[0][k][c][i];
+        for (b = 1; b < nb; b++)
+          if (t[b][k][c][i] < tmin)
+            tmin = t[b][k][c][i];
+
+        for (b = 0; b < nb; b++)
+          score[b] += t[b][k][c][i] / tmin;
+      }
+
+      best = 0;
+      for (b = 1; b < nb; b++)
+        if (score[b] < score[best])
+          best = b;
+
+      message("Fastest for %s %s: %s", k == FFT_SIZE_COMPLEX ?
+              "complex" : "real", bench_class[c], backends[best]->name);
+    }
+}
@@ -0,0 +1,36 @@
+/*
+  fft.h - prototypes of the FFT front end functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_FFT
+#define H_FFT
+
+enum { FFT_ESTIMATE, FFT_MEASURE, FFT_PATIENT };
+enum { FFT_SIZE_REAL, FFT_SIZE_COMPLEX };
+
+extern int32_t fft_find_backend(char *name);
+extern void fft_init(char *wisdom_file, char *cost_file, int32_t effort,
+                     int32_t nthreads, int32_t backend_num);
+extern void fft_cleanup(void);
+extern void fft(real *in, real *out, int32_t N, uint8_t method);
+extern void fft_many(real *in, real *out, int32_t N, int32_t howmany,
+                     uint8_t method);
+extern void fft_threaded(real *in, real *out, int32_t N, uint8_t method);
+extern void fft_complex(real *in, real *out, int32_t N, uint8_t method);
+extern void fft_complex_many(real *in, real *out, int32_t N, int32_t howmany,
+                             uint8_t method);
+extern int32_t fft_size(int32_t n, int32_t kind);
+extern void fft_size_weights(double *w, int32_t set);
+extern void fft_bench(void);
+
+#endif
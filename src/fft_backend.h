@@ -0,0 +1,54 @@
+/*
+  fft_backend.h - interface between the FFT front end and its backends
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_FFT_BACKEND
+#define H_FFT_BACKEND
+
+// transform methods: the r2r kinds of fft() followed by the complex ones
+
+#define R2HC			0	// real to half-complex (forward)
+#define HC2R			1	// half-complex to real (inverse)
+#define DHT			2	// discrete Hartley transform
+#define CPLX_FWD		3	// complex forward, e^-i
+#define CPLX_BWD		4	// complex backward, e^+i
+
+#define SIMD_ALIGN		16	// alignment the backends care about
+
+#define ALIGNMENT_OF(p)		((int32_t) ((uintptr_t) (p) % SIMD_ALIGN))
+
+// A backend computes unnormalised transforms with FFTW's conventions
+// (half-complex layout, signs). Plans are created once for a size,
+// method, batch size and array layout, then executed on any arrays with
+// the same layout, possibly from several threads at once.
+
+typedef struct
+{
+  char *name;
+
+  // returns the number of threads the backend can use (at most nthreads)
+  int32_t (*init)(char *wisdom_file, int32_t effort, int32_t nthreads);
+  void (*cleanup)(void);
+
+  void *(*plan)(real *in, real *out, int32_t N, int32_t howmany,
+                uint8_t method, int32_t nthreads);
+  void (*execute)(void *plan, real *in, real *out);
+  void (*destroy)(void *plan);
+} fft_backend_t;
+
+#ifndef ASPERES_NO_FFTW
+extern fft_backend_t fftw_backend;
+#endif
+extern fft_backend_t builtin_backend;
+
+#endif
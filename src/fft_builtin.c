@@ -0,0 +1,674 @@
+/*
+  fft_builtin.c - built-in mixed-radix FFT backend
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "fft_backend.h"
+
+#define PI			3.1415926535897932
+
+#define MAX_FACTORS		32	// enough for any 32-bit size
+#define MAX_RADIX		61	// larger prime factors use Bluestein
+
+// The complex transforms are recursive decimation in time transforms,
+// with dedicated butterflies for the radices 2, 3 and 4 (the sizes
+// chosen by fft_size() are mostly made of these) and a generic one for
+// the other small primes. Sizes having a larger prime factor are
+// computed as a convolution of 2^a * 3^b length (Bluestein's algorithm).
+//
+// Real transforms of even size N are computed as a complex transform
+// of size N/2 of the even/odd samples, odd sizes through a complex
+// transform of size N.
+
+typedef struct
+{
+  real re, im;
+} cpx_t;
+
+typedef struct cplan_s
+{
+  int32_t n;			// size of the complex transform
+  int32_t factors[MAX_FACTORS * 2];	// (radix, remaining size) pairs
+  cpx_t *tw;			// twiddle factors e^(sign * 2 pi i k / n)
+  int32_t sign;			// -1 = forward  +1 = backward
+
+  int32_t m;			// Bluestein convolution size, 0 if unused
+  cpx_t *chirp;			// e^(sign * pi i k^2 / n)
+  cpx_t *filter;		// transformed & scaled conjugate chirp
+  struct cplan_s *fwd, *bwd;	// plans of size m
+} cplan_t;
+
+typedef struct
+{
+  uint8_t method;
+  int32_t n;			// size of the transform
+  int32_t howmany;		// number of transforms in the batch
+  cplan_t *cp;			// complex plan (size n/2 for even real sizes)
+  cpx_t *rtw;			// e^(-2 pi i k / n), for the real transforms
+  int32_t work;			// number of complex elements of work space
+} bplan_t;
+
+static cplan_t *cplan_create(int32_t n, int32_t sign);
+
+//=====================================================================
+
+// returns the smallest 2^a * 3^b not smaller than n
+
+static int32_t
+next_23(int32_t n)
+{
+  int64_t p2, p3, best;
+
+  best = 1;
+  while (best < n)
+    best *= 2;
+
+  for (p3 = 1; p3 < 2 * (int64_t) n; p3 *= 3)
+  {
+    for (p2 = p3; p2 < n; p2 *= 2)
+      ;
+    if (p2 < best)
+      best = p2;
+  }
+
+  return (int32_t) best;
+}
+
+//=====================================================================
+
+// splits n into radices, 4 first then 2, 3 and increasing primes.
+// Returns 0 if a prime factor is larger than MAX_RADIX.
+
+static int32_t
+factorise(int32_t n, int32_t *f)
+{
+  int32_t p;
+
+  p = 4;
+  do
+  {
+    while (n % p != 0)
+    {
+      if (p == 4)
+        p = 2;
+      else if (p == 2)
+        p = 3;
+      else
+        p += 2;
+
+      if (p * p > n)
+        p = n;
+    }
+
+    if (p > MAX_RADIX)
+      return 0;
+
+    n /= p;
+    *f++ = p;
+    *f++ = n;
+  }
+  while (n > 1);
+
+  return 1;
+}
+
+//=====================================================================
+
+static void
+cplan_destroy(cplan_t *p)
+{
+  if (p == NULL)
+    return;
+
+  free(p->tw);
+  free(p->chirp);
+  free(p->filter);
+  cplan_destroy(p->fwd);
+  cplan_destroy(p->bwd);
+  free(p);
+}
+
+//=====================================================================
+
+// the butterflies combine r transforms of size m into one of size r * m,
+// the twiddle factors being read with the stride fstride
+
+static void
+bfly2(cpx_t *out, int32_t fstride, cplan_t *p, int32_t m)
+{
+  int32_t u;
+  cpx_t t, *w;
+
+  for (u = 0; u < m; u++)
+  {
+    w = &p->tw[u * fstride];
+    t.re = out[u + m].re * w->re - out[u + m].im * w->im;
+    t.im = out[u + m].re * w->im + out[u + m].im * w->re;
+    out[u + m].re = out[u].re - t.re;
+    out[u + m].im = out[u].im - t.im;
+    out[u].re += t.re;
+    out[u].im += t.im;
+  }
+}
+
+//=====================================================================
+
+static void
+bfly3(cpx_t *out, int32_t fstride, cplan_t *p, int32_t m)
+{
+  int32_t u;
+  double h;
+  cpx_t y1, y2, s, d, *w1, *w2;
+
+  h = p->sign * 0.8660254037844386;	// sign * sqrt(3) / 2
+
+  for (u = 0; u < m; u++)
+  {
+    w1 = &p->tw[u * fstride];
+    w2 = &p->tw[2 * u * fstride];
+    y1.re = out[u + m].re * w1->re - out[u + m].im * w1->im;
+    y1.im = out[u + m].re * w1->im + out[u + m].im * w1->re;
+    y2.re = out[u + 2 * m].re * w2->re - out[u + 2 * m].im * w2->im;
+    y2.im = out[u + 2 * m].re * w2->im + out[u + 2 * m].im * w2->re;
+
+    s.re = y1.re + y2.re;
+    s.im = y1.im + y2.im;
+    d.re = h * (y1.re - y2.re);
+    d.im = h * (y1.im - y2.im);
+
+    out[u + m].re = out[u].re - 0.5 * s.re - d.im;
+    out[u + m].im = out[u].im - 0.5 * s.im + d.re;
+    out[u + 2 * m].re = out[u].re - 0.5 * s.re + d.im;
+    out[u + 2 * m].im = out[u].im - 0.5 * s.im - d.re;
+    out[u].re += s.re;
+    out[u].im += s.im;
+  }
+}
+
+//=====================================================================
+
+static void
+bfly4(cpx_t *out, int32_t fstride, cplan_t *p, int32_t m)
+{
+  int32_t u;
+  cpx_t y1, y2, y3, s3, s4, s5, *w1, *w2, *w3;
+
+  for (u = 0; u < m; u++)
+  {
+    w1 = &p->tw[u * fstride];
+    w2 = &p->tw[2 * u * fstride];
+    w3 = &p->tw[3 * u * fstride];
+    y1.re = out[u + m].re * w1->re - out[u + m].im * w1->im;
+    y1.im = out[u + m].re * w1->im + out[u + m].im * w1->re;
+    y2.re = out[u + 2 * m].re * w2->re - out[u + 2 * m].im * w2->im;
+    y2.im = out[u + 2 * m].re * w2->im + out[u + 2 * m].im * w2->re;
+    y3.re = out[u + 3 * m].re * w3->re - out[u + 3 * m].im * w3->im;
+    y3.im = out[u + 3 * m].re * w3->im + out[u + 3 * m].im * w3->re;
+
+    s5.re = out[u].re - y2.re;
+    s5.im = out[u].im - y2.im;
+    out[u].re += y2.re;
+    out[u].im += y2.im;
+    s3.re = y1.re + y3.re;
+    s3.im = y1.im + y3.im;
+    s4.re = p->sign * (y1.re - y3.re);	// times the sign so that
+    s4.im = p->sign * (y1.im - y3.im);	// s5 + i * s4 is output 1
+
+    out[u + 2 * m].re = out[u].re - s3.re;
+    out[u + 2 * m].im = out[u].im - s3.im;
+    out[u].re += s3.re;
+    out[u].im += s3.im;
+    out[u + m].re = s5.re - s4.im;
+    out[u + m].im = s5.im + s4.re;
+    out[u + 3 * m].re = s5.re + s4.im;
+    out[u + 3 * m].im = s5.im - s4.re;
+  }
+}
+
+//=====================================================================
+
+static void
+bfly_generic(cpx_t *out, int32_t fstride, cplan_t *p, int32_t m, int32_t r)
+{
+  int32_t u, q, k, t;
+  cpx_t y[MAX_RADIX], sum, *w;
+
+  for (u = 0; u < m; u++)
+  {
+    for (q = 0; q < r; q++)
+    {
+      w = &p->tw[(int64_t) q * u * fstride % p->n];
+      y[q].re = out[u + q * m].re * w->re - out[u + q * m].im * w->im;
+      y[q].im = out[u + q * m].re * w->im + out[u + q * m].im * w->re;
+    }
+
+    for (k = 0; k < r; k++)
+    {
+      sum = y[0];
+      t = 0;
+      for (q = 1; q < r; q++)
+      {
+        t += k * m * fstride;	// index of e^(sign 2 pi i q k / r)
+        if (t >= p->n)
+          t %= p->n;
+        w = &p->tw[t];
+        sum.re += y[q].re * w->re - y[q].im * w->im;
+        sum.im += y[q].re * w->im + y[q].im * w->re;
+      }
+      out[u + k * m] = sum;
+    }
+  }
+}
+
+//=====================================================================
+
+// transform of the elements in[0], in[fstride], ... into out[]
+
+static void
+work(cplan_t *p, cpx_t *out, cpx_t *in, int32_t fstride, int32_t *f)
+{
+  int32_t q, r, m;
+
+  r = f[0];
+  m = f[1];
+
+  if (m == 1)
+    for (q = 0; q < r; q++)
+      out[q] = in[q * fstride];
+  else
+    for (q = 0; q < r; q++)
+      work(p, &out[q * m], &in[q * fstride], fstride * r, f + 2);
+
+  switch (r)
+  {
+    case 2:
+      bfly2(out, fstride, p, m);
+      break;
+
+    case 3:
+      bfly3(out, fstride, p, m);
+      break;
+
+    case 4:
+      bfly4(out, fstride, p, m);
+      break;
+
+    default:
+      bfly_generic(out, fstride, p, m, r);
+      break;
+  }
+}
+
+//=====================================================================
+
+// out-of-place complex transform, 'scratch' holds 2 * m elements for the
+// Bluestein plans
+
+static void
+cplan_execute(cplan_t *p, cpx_t *in, cpx_t *out, cpx_t *scratch)
+{
+  int32_t i;
+  cpx_t *a, *b, c;
+
+  if (p->m == 0)
+  {
+    work(p, out, in, 1, p->factors);
+    return;
+  }
+
+  a = scratch;
+  b = scratch + p->m;
+
+  for (i = 0; i < p->n; i++)
+  {
+    a[i].re = in[i].re * p->chirp[i].re - in[i].im * p->chirp[i].im;
+    a[i].im = in[i].re * p->chirp[i].im + in[i].im * p->chirp[i].re;
+  }
+  memset(&a[p->n], 0, (p->m - p->n) * sizeof(cpx_t));
+
+  work(p->fwd, b, a, 1, p->fwd->factors);
+
+  for (i = 0; i < p->m; i++)
+  {
+    c = b[i];
+    b[i].re = c.re * p->filter[i].re - c.im * p->filter[i].im;
+    b[i].im = c.re * p->filter[i].im + c.im * p->filter[i].re;
+  }
+
+  work(p->bwd, a, b, 1, p->bwd->factors);
+
+  for (i = 0; i < p->n; i++)
+  {
+    out[i].re = a[i].re * p->chirp[i].re - a[i].im * p->chirp[i].im;
+    out[i].im = a[i].re * p->chirp[i].im + a[i].im * p->chirp[i].re;
+  }
+}
+
+//=====================================================================
+
+static cplan_t *
+cplan_create(int32_t n, int32_t sign)
+{
+  int32_t i;
+  int64_t k2;
+  double a;
+  cplan_t *p;
+  cpx_t *b, *scratch;
+
+  p = calloc(1, sizeof(cplan_t));
+  p->n = n;
+  p->sign = sign;
+
+  p->tw = malloc(n * sizeof(cpx_t));
+  for (i = 0; i < n; i++)
+  {
+    a = 2.0 * PI * i / n;
+    p->tw[i].re = cos(a);
+    p->tw[i].im = sign * sin(a);
+  }
+
+  if (factorise(n, p->factors))
+    return p;
+
+  // Bluestein: X[k] = c[k] * sum(x[j] * c[j] * conj(c[k - j])),
+  // c[k] = e^(sign * pi i k^2 / n), the sum being a circular convolution
+  // of length m >= 2n - 1
+
+  p->m = next_23(2 * n - 1);
+  p->fwd = cplan_create(p->m, -1);
+  p->bwd = cplan_create(p->m, 1);
+
+  p->chirp = malloc(n * sizeof(cpx_t));
+  for (i = 0; i < n; i++)
+  {
+    k2 = (int64_t) i * i % (2 * (int64_t) n);	// keeps the angle precise
+    a = PI * k2 / n;
+    p->chirp[i].re = cos(a);
+    p->chirp[i].im = sign * sin(a);
+  }
+
+  b = calloc(p->m, sizeof(cpx_t));
+  for (i = 0; i < n; i++)
+  {
+    b[i].re = p->chirp[i].re / p->m;	// the 1/m of the inverse transform
+    b[i].im = -p->chirp[i].im / p->m;
+    if (i > 0)
+      b[p->m - i] = b[i];
+  }
+
+  p->filter = malloc(p->m * sizeof(cpx_t));
+  scratch = b;
+  work(p->fwd, p->filter, scratch, 1, p->fwd->factors);
+  free(b);
+
+  return p;
+}
+
+//=====================================================================
+
+static int32_t
+builtin_init(char *wisdom_file, int32_t effort, int32_t nthreads)
+{
+  return 1;			// no planning effort, no threads
+}
+
+//=====================================================================
+
+static void
+builtin_cleanup(void)
+{
+}
+
+//=====================================================================
+
+static void *
+builtin_plan
+(
+  real *in, real *out, int32_t N, int32_t howmany, uint8_t method,
+  int32_t nthreads
+)
+{
+  int32_t i, h;
+  double a;
+  bplan_t *p;
+
+  p = calloc(1, sizeof(bplan_t));
+  p->method = method;
+  p->n = N;
+  p->howmany = howmany;
+
+  if (method == CPLX_FWD || method == CPLX_BWD)
+  {
+    p->cp = cplan_create(N, method == CPLX_FWD ? -1 : 1);
+    p->work = N;
+  }
+  else if (N % 2 == 0)
+  {
+    h = N / 2;
+    p->cp = cplan_create(h, method == HC2R ? 1 : -1);
+    p->rtw = malloc(h * sizeof(cpx_t));
+    for (i = 0; i < h; i++)
+    {
+      a = 2.0 * PI * i / N;
+      p->rtw[i].re = cos(a);
+      p->rtw[i].im = -sin(a);
+    }
+    p->work = h;
+  }
+  else
+  {
+    p->cp = cplan_create(N, method == HC2R ? 1 : -1);
+    p->work = 2 * N;
+  }
+
+  p->work += 2 * p->cp->m;
+
+  return p;
+}
+
+//=====================================================================
+
+// real to half-complex transform of x into hc (which may be x)
+
+static void
+r2hc(bplan_t *p, real *x, real *hc, cpx_t *w)
+{
+  int32_t k, h, n;
+  cpx_t *z, *s, e, o, zk, zc, t;
+
+  n = p->n;
+
+  if (n % 2 == 1)
+  {
+    z = w;
+    s = w + n;
+    for (k = 0; k < n; k++)
+    {
+      z[k].re = x[k];
+      z[k].im = 0.0;
+    }
+
+    cplan_execute(p->cp, z, z + n, s + n);
+    z += n;
+
+    hc[0] = z[0].re;
+    for (k = 1; k <= n / 2; k++)
+    {
+      hc[k] = z[k].re;
+      hc[n - k] = z[k].im;
+    }
+    return;
+  }
+
+  // the even and odd samples are the real and imaginary parts of z
+  h = n / 2;
+  z = w;
+  cplan_execute(p->cp, (cpx_t *) x, z, w + h);
+
+  hc[0] = z[0].re + z[0].im;
+  hc[h] = z[0].re - z[0].im;
+
+  for (k = 1; k < h; k++)
+  {
+    zk = z[k];
+    zc.re = z[h - k].re;
+    zc.im = -z[h - k].im;
+
+    e.re = 0.5 * (zk.re + zc.re);	// transform of the even samples
+    e.im = 0.5 * (zk.im + zc.im);
+    o.re = 0.5 * (zk.im - zc.im);	// transform of the odd samples
+    o.im = -0.5 * (zk.re - zc.re);
+
+    t.re = o.re * p->rtw[k].re - o.im * p->rtw[k].im;
+    t.im = o.re * p->rtw[k].im + o.im * p->rtw[k].re;
+
+    hc[k] = e.re + t.re;
+    hc[n - k] = e.im + t.im;
+  }
+}
+
+//=====================================================================
+
+// half-complex to real transform of hc into x (which may be hc)
+
+static void
+hc2r(bplan_t *p, real *hc, real *x, cpx_t *w)
+{
+  int32_t k, h, n;
+  cpx_t *z, xk, xc, d, t;
+
+  n = p->n;
+
+  if (n % 2 == 1)
+  {
+    z = w;
+    z[0].re = hc[0];
+    z[0].im = 0.0;
+    for (k = 1; k <= n / 2; k++)
+    {
+      z[k].re = z[n - k].re = hc[k];
+      z[k].im = hc[n - k];
+      z[n - k].im = -hc[n - k];
+    }
+
+    cplan_execute(p->cp, z, z + n, z + 2 * n);
+    z += n;
+
+    for (k = 0; k < n; k++)
+      x[k] = z[k].re;
+    return;
+  }
+
+  h = n / 2;
+  z = w;
+
+  for (k = 0; k < h; k++)
+  {
+    xk.re = hc[k];
+    xk.im = (k == 0) ? 0.0 : hc[n - k];
+    xc.re = hc[h - k];			// conj(X[h - k])
+    xc.im = (k == 0) ? 0.0 : -hc[n - h + k];
+
+    d.re = xk.re - xc.re;		// (X[k] - conj(X[h - k])) * e^(2 pi i k / n)
+    d.im = xk.im - xc.im;
+    t.re = d.re * p->rtw[k].re + d.im * p->rtw[k].im;
+    t.im = d.im * p->rtw[k].re - d.re * p->rtw[k].im;
+
+    z[k].re = xk.re + xc.re - t.im;
+    z[k].im = xk.im + xc.im + t.re;
+  }
+
+  cplan_execute(p->cp, z, (cpx_t *) x, w + h);
+}
+
+//=====================================================================
+
+static void
+builtin_execute(void *plan, real *in, real *out)
+{
+  bplan_t *p = plan;
+  int32_t b, k, n, len;
+  cpx_t *w;
+  real *hc;
+
+  n = p->n;
+  len = (p->method == CPLX_FWD || p->method == CPLX_BWD) ? 2 * n : n;
+  w = (cpx_t *) buf_alloc((p->work + n) * 2);	// thread safe work space
+
+  for (b = 0; b < p->howmany; b++, in += len, out += len)
+  {
+    switch (p->method)
+    {
+      case CPLX_FWD:
+      case CPLX_BWD:
+        if (in == out)
+        {
+          memcpy(w, in, n * sizeof(cpx_t));
+          cplan_execute(p->cp, w, (cpx_t *) out, w + n);
+        }
+        else
+          cplan_execute(p->cp, (cpx_t *) in, (cpx_t *) out, w);
+        break;
+
+      case R2HC:
+        r2hc(p, in, out, w);
+        break;
+
+      case HC2R:
+        hc2r(p, in, out, w);
+        break;
+
+      case DHT:
+        hc = (real *) (w + p->work);
+        r2hc(p, in, hc, w);
+        out[0] = hc[0];
+        for (k = 1; k < n - k; k++)
+        {
+          out[k] = hc[k] - hc[n - k];
+          out[n - k] = hc[k] + hc[n - k];
+        }
+        if (n % 2 == 0)
+          out[n / 2] = hc[n / 2];
+        break;
+    }
+  }
+
+  buf_free((real *) w);
+}
+
+//=====================================================================
+
+static void
+builtin_destroy(void *plan)
+{
+  bplan_t *p = plan;
+
+  cplan_destroy(p->cp);
+  free(p->rtw);
+  free(p);
+}
+
+//=====================================================================
+
+fft_backend_t builtin_backend =
+{
+  "builtin", builtin_init, builtin_cleanup, builtin_plan, builtin_execute,
+  builtin_destroy
+};
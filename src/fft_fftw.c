@@ -0,0 +1,245 @@
+/*
+  fft_fftw.c - FFT backend using the FFTW library
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef ASPERES_NO_FFTW
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <fftw3.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "fft.h"
+#include "fft_backend.h"
+
+// FFTW prefixes its single precision API with 'fftwf_'
+
+#ifdef ASPERES_FLOAT
+#define FFTW(name)		fftwf_##name
+#else
+#define FFTW(name)		fftw_##name
+#endif
+
+typedef struct
+{
+  FFTW(plan) p;
+  uint8_t method;
+} lib_plan_t;
+
+static unsigned plan_flags = FFTW_ESTIMATE;
+static char *wisdom_name = NULL;
+static int32_t threads_ok = 0;
+
+//=====================================================================
+
+// sets the planning effort, initialises the threads and loads previously
+// saved wisdom (if any)
+
+static int32_t
+lib_init(char *wisdom_file, int32_t effort, int32_t nthreads)
+{
+  FILE *f;
+
+  threads_ok = 0;
+  if (nthreads > 1)
+  {
+    if (FFTW(init_threads)())
+      threads_ok = 1;
+    else
+    {
+      message("Warning: cannot initialise the FFT threads.");
+      nthreads = 1;
+    }
+  }
+
+  if (effort == FFT_PATIENT)
+    plan_flags = FFTW_PATIENT;
+  else if (effort == FFT_MEASURE)
+    plan_flags = FFTW_MEASURE;
+  else
+    plan_flags = FFTW_ESTIMATE;
+
+  wisdom_name = NULL;
+  if (wisdom_file == NULL || wisdom_file[0] == 0)
+    return nthreads;
+
+  wisdom_name = wisdom_file;
+
+  f = fopen(wisdom_name, "r");
+  if (f == NULL)
+    return nthreads;
+
+  if (FFTW(import_wisdom_from_file)(f))
+    message("FFT wisdom loaded from '%s'", wisdom_name);
+  else
+    message("Warning: invalid FFT wisdom file '%s'.", wisdom_name);
+
+  fclose(f);
+
+  return nthreads;
+}
+
+//=====================================================================
+
+// saves the accumulated wisdom
+
+static void
+lib_cleanup(void)
+{
+  FILE *f;
+
+  if (wisdom_name != NULL && plan_flags != FFTW_ESTIMATE)
+  {
+    f = fopen(wisdom_name, "w");
+    if (f == NULL)
+      message("Warning: cannot save FFT wisdom to '%s'.", wisdom_name);
+    else
+    {
+      FFTW(export_wisdom_to_file)(f);
+      fclose(f);
+    }
+  }
+
+  if (threads_ok)
+    FFTW(cleanup_threads)();
+  threads_ok = 0;
+}
+
+//=====================================================================
+
+// creates a r2r or complex plan for 'howmany' transforms of size N
+// stored one after the other
+
+static FFTW(plan)
+plan_1d
+(
+  real *in, real *out, int32_t N, int32_t howmany, uint8_t method,
+  unsigned flags
+)
+{
+  int dir;
+  FFTW(r2r_kind) kind;
+
+  dir = (method == CPLX_FWD) ? FFTW_FORWARD : FFTW_BACKWARD;
+  kind = method;
+
+  if (howmany == 1)
+  {
+    if (method == CPLX_FWD || method == CPLX_BWD)
+      return FFTW(plan_dft_1d)(N, (FFTW(complex) *) in, (FFTW(complex) *) out,
+                              dir, flags);
+    else
+      return FFTW(plan_r2r_1d)(N, in, out, kind, flags);
+  }
+
+  if (method == CPLX_FWD || method == CPLX_BWD)
+    return FFTW(plan_many_dft)(1, &N, howmany,
+                              (FFTW(complex) *) in, NULL, 1, N,
+                              (FFTW(complex) *) out, NULL, 1, N,
+                              dir, flags);
+  else
+    return FFTW(plan_many_r2r)(1, &N, howmany, in, NULL, 1, N,
+                              out, NULL, 1, N, &kind, flags);
+}
+
+//=====================================================================
+
+// creates a plan for arrays laid out like 'in' and 'out'.
+// FFTW_MEASURE and FFTW_PATIENT overwrite the arrays while planning, so
+// in that case the plan is made on scratch arrays with the same alignment.
+
+static void *
+lib_plan
+(
+  real *in, real *out, int32_t N, int32_t howmany, uint8_t method,
+  int32_t nthreads
+)
+{
+  lib_plan_t *p;
+  int32_t len;
+  real *a, *b, *tin, *tout;
+
+  p = malloc(sizeof(lib_plan_t));
+  p->method = method;
+
+  if (threads_ok)
+    FFTW(plan_with_nthreads)(nthreads);
+
+  if (plan_flags == FFTW_ESTIMATE)
+  {
+    p->p = plan_1d(in, out, N, howmany, method, FFTW_ESTIMATE);
+    return p;
+  }
+
+  len = N * howmany;
+  if (method == CPLX_FWD || method == CPLX_BWD)
+    len *= 2;
+
+  // the spare elements leave room for the alignment offset
+  len += SIMD_ALIGN / sizeof(real);
+  a = buf_alloc(len);
+  tin = (real *) ((char *) a + ALIGNMENT_OF(in));
+
+  if (in == out)
+  {
+    b = NULL;
+    tout = tin;
+  }
+  else
+  {
+    b = buf_alloc(len);
+    tout = (real *) ((char *) b + ALIGNMENT_OF(out));
+  }
+
+  p->p = plan_1d(tin, tout, N, howmany, method, plan_flags);
+
+  buf_free(a);
+  buf_free(b);
+
+  return p;
+}
+
+//=====================================================================
+
+static void
+lib_execute(void *plan, real *in, real *out)
+{
+  lib_plan_t *p = plan;
+
+  if (p->method == CPLX_FWD || p->method == CPLX_BWD)
+    FFTW(execute_dft)(p->p, (FFTW(complex) *) in, (FFTW(complex) *) out);
+  else
+    FFTW(execute_r2r)(p->p, in, out);
+}
+
+//=====================================================================
+
+static void
+lib_destroy(void *plan)
+{
+  lib_plan_t *p = plan;
+
+  FFTW(destroy_plan)(p->p);
+  free(p);
+}
+
+//=====================================================================
+
+fft_backend_t fftw_backend =
+{
+  "fftw", lib_init, lib_cleanup, lib_plan, lib_execute, lib_destroy
+};
+
+#endif
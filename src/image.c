@@ -0,0 +1,201 @@
+/*
+  image.c - the spectrogram image type
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "image.h"
+
+//=====================================================================
+
+static size_t
+elem_size(int32_t type)
+{
+  return type == IMAGE_U8 ? sizeof(uint8_t) : sizeof(real);
+}
+
+//=====================================================================
+
+// allocates an image of width by height elements of the given type, set
+// to zero
+
+image_t *
+image_new(int32_t width, int32_t height, int32_t type)
+{
+  int32_t step;
+  size_t size;
+  image_t *image;
+
+  if (width < 1)
+    width = 1;
+
+  step = BUF_ALIGN / elem_size(type);	// elements per aligned block
+
+  image = malloc(sizeof(image_t));
+  image->width = width;
+  image->height = height;
+  image->stride = (width + step - 1) / step * step;
+  image->type = type;
+
+  size = image_size(image) * elem_size(type);
+
+  image->block = calloc(1, size + BUF_ALIGN);
+  if (image->block == NULL)
+  {
+    message("Out of memory (%dx%d image).", width, height);
+    exit(1);
+  }
+
+  image->data = (void *) (((uintptr_t) image->block + BUF_ALIGN - 1) &
+                          ~(uintptr_t) (BUF_ALIGN - 1));
+
+  return image;
+}
+
+//=====================================================================
+
+void
+image_free(image_t *image)
+{
+  if (image == NULL)
+    return;
+
+  free(image->block);
+  free(image);
+}
+
+//=====================================================================
+
+// returns the number of elements of the image, padding included
+
+size_t
+image_size(image_t *image)
+{
+  return (size_t) image->height * image->stride;
+}
+
+//=====================================================================
+
+real *
+image_row(image_t *image, int32_t y)
+{
+  return (real *) image->data + (size_t) y * image->stride;
+}
+
+//=====================================================================
+
+uint8_t *
+image_row_u8(image_t *image, int32_t y)
+{
+  return (uint8_t *) image->data + (size_t) y * image->stride;
+}
+
+//=====================================================================
+
+// returns the level of sample x scaled by k, computed like the
+// separate passes do it
+
+static int32_t
+level(real x, real k, double ratio)
+{
+  double vald;
+
+  x *= k;				// normalisation
+
+  if (ratio != 1.0)
+    x = pow(x, ratio);			// brightness control
+
+  vald = x * 255.0;
+
+  if (vald > 255.0)
+    vald = 255.0;
+
+  if (vald < 0.0)
+    vald = 0.0;
+
+  return (uint8_t) vald;
+}
+
+//=====================================================================
+
+// finds the smallest sample of every level by bisection, the levels
+// growing with the samples. A level no sample reaches gets an infinite
+// threshold.
+
+void
+quant_init(quant_t *q, double max, double ratio)
+{
+  int32_t l;
+  real k, lo, hi, mid;
+
+  k = max != 0.0 ? 1.0 / max : 0.0;
+  q->t[0] = 0.0;
+
+  for (l = 1; l < 256; l++)
+  {
+    lo = 0.0;
+    hi = k != 0.0 ? 2.0 / k : 0.0;	// far enough to be level 255
+
+    if (level(hi, k, ratio) < l)
+    {
+      q->t[l] = HUGE_VAL;
+      continue;
+    }
+
+    while (1)
+    {
+      mid = lo + (hi - lo) / 2;
+      if (mid <= lo || mid >= hi)	// adjacent values
+        break;
+
+      if (level(mid, k, ratio) >= l)
+        hi = mid;
+      else
+        lo = mid;
+    }
+
+    q->t[l] = hi;
+  }
+}
+
+//=====================================================================
+
+// out[i] = the level of in[i], found in 8 steps of a branchless search
+// of the thresholds
+
+void
+quant_row(quant_t *q, uint8_t *out, real *in, int32_t n)
+{
+  int32_t i, l;
+  real x;
+
+  for (i = 0; i < n; i++)
+  {
+    x = in[i];
+    l = 0;
+    l += (x >= q->t[l + 128]) << 7;
+    l += (x >= q->t[l + 64]) << 6;
+    l += (x >= q->t[l + 32]) << 5;
+    l += (x >= q->t[l + 16]) << 4;
+    l += (x >= q->t[l + 8]) << 3;
+    l += (x >= q->t[l + 4]) << 2;
+    l += (x >= q->t[l + 2]) << 1;
+    l += (x >= q->t[l + 1]);
+    out[i] = l;
+  }
+}
@@ -0,0 +1,53 @@
+/*
+  image.h - the spectrogram image type
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_IMAGE
+#define H_IMAGE
+
+enum { IMAGE_REAL, IMAGE_U8 };
+
+// An image is a single block of height rows, one per band, the top one
+// (the highest band) first. Every row starts on a BUF_ALIGN boundary,
+// 'stride' elements after the previous one, and the padding after its
+// last column is zero, so the whole block can be run through the
+// kernels at once.
+
+typedef struct
+{
+  int32_t width, height;	// columns & rows
+  int32_t stride;		// elements from one row to the next
+  int32_t type;			// IMAGE_REAL or IMAGE_U8
+  void *data;			// the first row
+  void *block;			// what malloc() returned
+} image_t;
+
+// The 8-bit levels of the samples of an image normalised to 'max' and
+// gamma corrected, 255 * (x / max) ^ ratio clamped to 0 .. 255 like
+// normalising, brightness_control() and quantising in turn would give,
+// in a single pass. t[k] is the smallest sample of level k.
+
+typedef struct
+{
+  real t[256];
+} quant_t;
+
+extern image_t *image_new(int32_t width, int32_t height, int32_t type);
+extern void image_free(image_t *image);
+extern size_t image_size(image_t *image);
+extern real *image_row(image_t *image, int32_t y);
+extern uint8_t *image_row_u8(image_t *image, int32_t y);
+extern void quant_init(quant_t *q, double max, double ratio);
+extern void quant_row(quant_t *q, uint8_t *out, real *in, int32_t n);
+
+#endif
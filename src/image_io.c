@@ -17,15 +17,18 @@
 #include <stdint.h>
 
 #include "util.h"
+#include "buffer.h"
+#include "image.h"
 #include "image_io.h"
 
-double **
-bmp_in(FILE * bmpfile, int32_t * y, int32_t * x)
+image_t *
+bmp_in(FILE * bmpfile)
 {
   int32_t iy, ix, ic;		// various iterators
-  int32_t offset;
-  double **image;
-  uint8_t zerobytes, val;
+  int32_t offset, x, y;
+  image_t *image;
+  real *row;
+  uint8_t zerobytes, *line;
 
   if (fread_le_short(bmpfile) != 19778)	// "BM" format tag check
   {
@@ -36,8 +39,8 @@ bmp_in(FILE * bmpfile, int32_t * y, int32_t * x)
   fseek(bmpfile, 8, SEEK_CUR);	// skipping useless tags
   offset = fread_le_word(bmpfile) - 54;	// header offset
   fseek(bmpfile, 4, SEEK_CUR);	// skipping useless tags
-  *x = fread_le_word(bmpfile);
-  *y = fread_le_word(bmpfile);
+  x = fread_le_word(bmpfile);
+  y = fread_le_word(bmpfile);
   fseek(bmpfile, 2, SEEK_CUR);	// skipping useless tags
 
   if (fread_le_short(bmpfile) != 24)	// Only format supported
@@ -48,40 +51,52 @@ bmp_in(FILE * bmpfile, int32_t * y, int32_t * x)
 
   fseek(bmpfile, 24 + offset, SEEK_CUR);	// skipping useless tags
 
-  image = malloc(*y * sizeof(double));	// image allocation
-  for (iy = 0; iy < *y; iy++)
-    image[iy] = calloc(*x, sizeof(double));
+  image = image_new(x, y, IMAGE_REAL);	// image allocation
 
-
-  zerobytes = 4 - ((*x * 3) & 3);
+  zerobytes = 4 - ((x * 3) & 3);
   if (zerobytes == 4)
     zerobytes = 0;
 
-  for (iy = *y - 1; iy != -1; iy--)	// backwards reading
+  line = calloc(x * 3 + zerobytes, 1);
+
+  for (iy = y - 1; iy != -1; iy--)	// backwards reading
   {
-    for (ix = 0; ix < *x; ix++)
+    fread(line, 1, x * 3 + zerobytes, bmpfile);	// a row & its padding
+    row = image_row(image, iy);
+
+    for (ix = 0; ix < x; ix++)
     {
       for (ic = 2; ic != -1; ic--)
-      {
-	fread(&val, 1, 1, bmpfile);
-	image[iy][ix] += (double) val *(1.0 / (255.0 * 3.0));	// Conversion to grey by averaging the three channels
-      }
+	row[ix] += (double) line[ix * 3 + 2 - ic] * (1.0 / (255.0 * 3.0));	// Conversion to grey by averaging the three channels
     }
-
-    fseek(bmpfile, zerobytes, SEEK_CUR);	// skipping padding bytes
   }
 
+  free(line);
   fclose(bmpfile);
   return image;
 }
 
-void
-bmp_out(FILE * bmpfile, double **image, int32_t y, int32_t x)
+// returns 1 if the sizes of a 24-bit BMP image of x by y pixels fit in
+// the 32-bit fields of its header, 0 otherwise
+
+int32_t
+bmp_fits(int32_t y, int32_t x)
+{
+  int64_t stride;
+
+  stride = ((int64_t) x * 3 + 3) & ~3;
+
+  return 56 + stride * y <= UINT32_MAX;
+}
+
+// writes the header of a 24-bit BMP image of x by y pixels, which
+// bmp_fits(), returns the length of a row in the file
+
+static int32_t
+bmp_header(FILE * bmpfile, int32_t y, int32_t x)
 {
-  int32_t i, iy, ix, ic;	// various iterators
-  int32_t filesize, imagesize;
-  uint8_t zerobytes, val, zero = 0;
-  double vald;
+  uint32_t filesize, imagesize;
+  uint8_t zerobytes;
 
   zerobytes = 4 - ((x * 3) & 3);	// computation of zero bytes
   if (zerobytes == 4)
@@ -89,8 +104,8 @@ bmp_out(FILE * bmpfile, double **image, int32_t y, int32_t x)
 
   //********Tags********
 
-  filesize = 56 + ((x * 3) + zerobytes) * y;
-  imagesize = 2 + ((x * 3) + zerobytes) * y;
+  filesize = 56 + (uint32_t) ((x * 3) + zerobytes) * y;
+  imagesize = 2 + (uint32_t) ((x * 3) + zerobytes) * y;
 
   fwrite_le_short(19778, bmpfile);
   fwrite_le_word(filesize, bmpfile);
@@ -109,28 +124,145 @@ bmp_out(FILE * bmpfile, double **image, int32_t y, int32_t x)
   fwrite_le_word(0, bmpfile);
   //--------Tags--------
 
-  for (iy = y - 1; iy != -1; iy--)	// backwards writing
+  return x * 3 + zerobytes;
+}
+
+// converts the first n columns of row iy to grey pixels in line, the
+// samples of a real image quantised by q
+
+static void
+bmp_line(image_t *image, int32_t iy, int32_t n, quant_t *q, uint8_t *line)
+{
+  int32_t ix;
+  uint8_t *src;
+
+  if (image->type == IMAGE_U8)
+    src = image_row_u8(image, iy);
+  else
   {
-    for (ix = 0; ix < x; ix++)
-    {
-      vald = image[iy][ix] * 255.0;
+    quant_row(q, line, image_row(image, iy), n);	// the levels first,
+    src = line;						// spread out backwards
+  }
 
-      if (vald > 255.0)
-	vald = 255.0;
+  for (ix = n - 1; ix >= 0; ix--)
+    line[ix * 3] = line[ix * 3 + 1] = line[ix * 3 + 2] = src[ix];
+}
 
-      if (vald < 0.0)
-	vald = 0.0;
+void
+bmp_out(FILE * bmpfile, image_t * image, quant_t * q)
+{
+  int32_t iy, x, y, stride;
+  uint8_t *line;
 
-      val = vald;
+  x = image->width;
+  y = image->height;
+  stride = bmp_header(bmpfile, y, x);
+  line = calloc(stride, 1);	// the padding bytes stay zero
 
-      for (ic = 2; ic != -1; ic--)
-	fwrite(&val, 1, 1, bmpfile);
-    }
-    for (i = 0; i < zerobytes; i++)
-      fwrite(&zero, 1, 1, bmpfile);	// write padding bytes
+  for (iy = y - 1; iy != -1; iy--)	// backwards writing
+  {
+    bmp_line(image, iy, x, q, line);
+    fwrite(line, 1, stride, bmpfile);
   }
 
+  free(line);
+
   fwrite_le_short(0, bmpfile);
 
   fclose(bmpfile);
 }
+
+// creates a blank 24-bit BMP image of x by y pixels, to be filled in by
+// bmp_put_columns() and closed by the caller
+
+void
+bmp_create(FILE * bmpfile, int32_t y, int32_t x)
+{
+  int32_t stride;
+
+  stride = bmp_header(bmpfile, y, x);
+
+  file_seek(bmpfile, 54 + (int64_t) stride * y);	// the rest reads as zeros
+  fwrite_le_short(0, bmpfile);
+}
+
+// widens an image of x_old by y pixels, written by bmp_out() or made by
+// bmp_create(), to x columns in place, the new ones being black, to be
+// filled in by bmp_put_columns()
+
+void
+bmp_widen(FILE * bmpfile, int32_t y, int32_t x_old, int32_t x)
+{
+  int32_t r, stride_old, stride;
+  uint8_t *line;
+
+  stride_old = (x_old * 3 + 3) & ~3;
+
+  fseek(bmpfile, 0, SEEK_SET);
+  stride = bmp_header(bmpfile, y, x);
+  line = calloc(stride, 1);	// the new pixels & the padding stay zero
+
+  // the rows move towards the end of the file, so they are moved from
+  // the last one back, none overwriting a row not yet moved
+
+  for (r = y - 1; r >= 0; r--)
+  {
+    file_seek(bmpfile, 54 + (int64_t) r * stride_old);
+    fread(line, 1, x_old * 3, bmpfile);
+    file_seek(bmpfile, 54 + (int64_t) r * stride);
+    fwrite(line, 1, stride, bmpfile);
+  }
+
+  free(line);
+
+  file_seek(bmpfile, 54 + (int64_t) stride * y);
+  fwrite_le_short(0, bmpfile);
+}
+
+// writes the first n columns of image, quantised by q, as the columns
+// x0 .. x0 + n - 1 of an image of x columns created by bmp_create()
+
+void
+bmp_put_columns(FILE * bmpfile, image_t * image, int32_t x, int32_t x0,
+                int32_t n, quant_t * q)
+{
+  int32_t iy, y, stride;
+  uint8_t *line;
+
+  y = image->height;
+  stride = (x * 3 + 3) & ~3;
+  line = malloc(n * 3);
+
+  for (iy = 0; iy < y; iy++)
+  {
+    bmp_line(image, iy, n, q, line);
+
+    // rows are stored bottom up
+    file_seek(bmpfile, 54 + (int64_t) (y - 1 - iy) * stride + x0 * 3);
+    fwrite(line, 1, n * 3, bmpfile);
+  }
+
+  free(line);
+}
+
+// writes the first row of image, quantised by q, as row iy of an image
+// of y rows created by bmp_create(), as wide as the image
+
+void
+bmp_put_row(FILE * bmpfile, image_t * image, int32_t y, int32_t iy,
+            quant_t * q)
+{
+  int32_t stride;
+  uint8_t *line;
+
+  stride = (image->width * 3 + 3) & ~3;
+  line = malloc(image->width * 3);
+
+  bmp_line(image, 0, image->width, q, line);
+
+  // rows are stored bottom up
+  file_seek(bmpfile, 54 + (int64_t) (y - 1 - iy) * stride);
+  fwrite(line, 1, image->width * 3, bmpfile);
+
+  free(line);
+}
@@ -15,7 +15,14 @@
 #ifndef H_IMAGE_IO
 #define H_IMAGE_IO
 
-extern double **bmp_in(FILE * bmpfile, int32_t * y, int32_t * x);
-extern void bmp_out(FILE * bmpfile, double **image, int32_t y, int32_t x);
+extern image_t *bmp_in(FILE * bmpfile);
+extern int32_t bmp_fits(int32_t y, int32_t x);
+extern void bmp_out(FILE * bmpfile, image_t * image, quant_t * q);
+extern void bmp_create(FILE * bmpfile, int32_t y, int32_t x);
+extern void bmp_widen(FILE * bmpfile, int32_t y, int32_t x_old, int32_t x);
+extern void bmp_put_columns(FILE * bmpfile, image_t * image, int32_t x,
+			    int32_t x0, int32_t n, quant_t * q);
+extern void bmp_put_row(FILE * bmpfile, image_t * image, int32_t y,
+			int32_t iy, quant_t * q);
 
 #endif
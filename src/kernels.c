@@ -0,0 +1,308 @@
+/*
+  kernels.c - runtime selection of the vectorised DSP kernels
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "util.h"
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KERN_X86
+#include <immintrin.h>
+#endif
+
+kernels_t kern;
+
+static char *level_names[] = { "auto", "scalar", "sse2", "avx2", "avx512" };
+
+//=====================================================================
+// plain C
+//=====================================================================
+
+#define KFN(name)		name##_scalar
+#define KTARGET
+#define VT			real
+#define VL			1
+#define VLOAD(p)		(*(p))
+#define VSTORE(p, x)		(*(p) = (x))
+#define VSET1(x)		(x)
+#define VADD(a, b)		((a) + (b))
+#define VMUL(a, b)		((a) * (b))
+#define VSQRT(x)		sqrt(x)
+#define VMAX(a, b)		((a) > (b) ? (a) : (b))
+#define VABS(x)			fabs(x)
+#define VDEINT(a, b, re, im)	do { re = a; im = b; } while (0)
+#define VINTL(re, im, a, b)	do { a = re; b = im; } while (0)
+#define VREV(x)			(x)
+
+#include "kernels_tmpl.h"
+
+#ifdef KERN_X86
+
+//=====================================================================
+// SSE2
+//=====================================================================
+
+#define KFN(name)		name##_sse2
+#define KTARGET			__attribute__((target("sse2")))
+
+#ifdef ASPERES_FLOAT
+#define VT			__m128
+#define VL			4
+#define VLOAD(p)		_mm_loadu_ps(p)
+#define VSTORE(p, x)		_mm_storeu_ps(p, x)
+#define VSET1(x)		_mm_set1_ps(x)
+#define VADD(a, b)		_mm_add_ps(a, b)
+#define VMUL(a, b)		_mm_mul_ps(a, b)
+#define VSQRT(x)		_mm_sqrt_ps(x)
+#define VMAX(a, b)		_mm_max_ps(a, b)
+#define VABS(x)			_mm_andnot_ps(_mm_set1_ps(-0.0f), x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)); \
+  im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  a = _mm_unpacklo_ps(re, im); \
+  b = _mm_unpackhi_ps(re, im); } while (0)
+#define VREV(x)			_mm_shuffle_ps(x, x, _MM_SHUFFLE(0, 1, 2, 3))
+#else
+#define VT			__m128d
+#define VL			2
+#define VLOAD(p)		_mm_loadu_pd(p)
+#define VSTORE(p, x)		_mm_storeu_pd(p, x)
+#define VSET1(x)		_mm_set1_pd(x)
+#define VADD(a, b)		_mm_add_pd(a, b)
+#define VMUL(a, b)		_mm_mul_pd(a, b)
+#define VSQRT(x)		_mm_sqrt_pd(x)
+#define VMAX(a, b)		_mm_max_pd(a, b)
+#define VABS(x)			_mm_andnot_pd(_mm_set1_pd(-0.0), x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm_unpacklo_pd(a, b); \
+  im = _mm_unpackhi_pd(a, b); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  a = _mm_unpacklo_pd(re, im); \
+  b = _mm_unpackhi_pd(re, im); } while (0)
+#define VREV(x)			_mm_shuffle_pd(x, x, 1)
+#endif
+
+#include "kernels_tmpl.h"
+
+//=====================================================================
+// AVX2
+//=====================================================================
+
+#define KFN(name)		name##_avx2
+#define KTARGET			__attribute__((target("avx2")))
+
+#ifdef ASPERES_FLOAT
+#define VT			__m256
+#define VL			8
+#define VLOAD(p)		_mm256_loadu_ps(p)
+#define VSTORE(p, x)		_mm256_storeu_ps(p, x)
+#define VSET1(x)		_mm256_set1_ps(x)
+#define VADD(a, b)		_mm256_add_ps(a, b)
+#define VMUL(a, b)		_mm256_mul_ps(a, b)
+#define VSQRT(x)		_mm256_sqrt_ps(x)
+#define VMAX(a, b)		_mm256_max_ps(a, b)
+#define VABS(x)			_mm256_andnot_ps(_mm256_set1_ps(-0.0f), x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd( \
+         _mm256_shuffle_ps(a, b, 0x88)), 0xD8)); \
+  im = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd( \
+         _mm256_shuffle_ps(a, b, 0xDD)), 0xD8)); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  __m256 lo_ = _mm256_unpacklo_ps(re, im), hi_ = _mm256_unpackhi_ps(re, im); \
+  a = _mm256_permute2f128_ps(lo_, hi_, 0x20); \
+  b = _mm256_permute2f128_ps(lo_, hi_, 0x31); } while (0)
+#define VREV(x)			_mm256_permutevar8x32_ps(x, \
+  _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0))
+#else
+#define VT			__m256d
+#define VL			4
+#define VLOAD(p)		_mm256_loadu_pd(p)
+#define VSTORE(p, x)		_mm256_storeu_pd(p, x)
+#define VSET1(x)		_mm256_set1_pd(x)
+#define VADD(a, b)		_mm256_add_pd(a, b)
+#define VMUL(a, b)		_mm256_mul_pd(a, b)
+#define VSQRT(x)		_mm256_sqrt_pd(x)
+#define VMAX(a, b)		_mm256_max_pd(a, b)
+#define VABS(x)			_mm256_andnot_pd(_mm256_set1_pd(-0.0), x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm256_permute4x64_pd(_mm256_unpacklo_pd(a, b), 0xD8); \
+  im = _mm256_permute4x64_pd(_mm256_unpackhi_pd(a, b), 0xD8); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  __m256d lo_ = _mm256_unpacklo_pd(re, im), hi_ = _mm256_unpackhi_pd(re, im); \
+  a = _mm256_permute2f128_pd(lo_, hi_, 0x20); \
+  b = _mm256_permute2f128_pd(lo_, hi_, 0x31); } while (0)
+#define VREV(x)			_mm256_permute4x64_pd(x, 0x1B)
+#endif
+
+#include "kernels_tmpl.h"
+
+//=====================================================================
+// AVX-512
+//=====================================================================
+
+#define KFN(name)		name##_avx512
+#define KTARGET			__attribute__((target("avx512f")))
+
+#ifdef ASPERES_FLOAT
+#define VT			__m512
+#define VL			16
+#define VLOAD(p)		_mm512_loadu_ps(p)
+#define VSTORE(p, x)		_mm512_storeu_ps(p, x)
+#define VSET1(x)		_mm512_set1_ps(x)
+#define VADD(a, b)		_mm512_add_ps(a, b)
+#define VMUL(a, b)		_mm512_mul_ps(a, b)
+#define VSQRT(x)		_mm512_sqrt_ps(x)
+#define VMAX(a, b)		_mm512_max_ps(a, b)
+#define VABS(x)			_mm512_abs_ps(x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm512_permutex2var_ps(a, _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, \
+         14, 16, 18, 20, 22, 24, 26, 28, 30), b); \
+  im = _mm512_permutex2var_ps(a, _mm512_setr_epi32(1, 3, 5, 7, 9, 11, 13, \
+         15, 17, 19, 21, 23, 25, 27, 29, 31), b); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  a = _mm512_permutex2var_ps(re, _mm512_setr_epi32(0, 16, 1, 17, 2, 18, 3, \
+        19, 4, 20, 5, 21, 6, 22, 7, 23), im); \
+  b = _mm512_permutex2var_ps(re, _mm512_setr_epi32(8, 24, 9, 25, 10, 26, \
+        11, 27, 12, 28, 13, 29, 14, 30, 15, 31), im); } while (0)
+#define VREV(x)			_mm512_permutexvar_ps(_mm512_setr_epi32(15, \
+  14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0), x)
+#else
+#define VT			__m512d
+#define VL			8
+#define VLOAD(p)		_mm512_loadu_pd(p)
+#define VSTORE(p, x)		_mm512_storeu_pd(p, x)
+#define VSET1(x)		_mm512_set1_pd(x)
+#define VADD(a, b)		_mm512_add_pd(a, b)
+#define VMUL(a, b)		_mm512_mul_pd(a, b)
+#define VSQRT(x)		_mm512_sqrt_pd(x)
+#define VMAX(a, b)		_mm512_max_pd(a, b)
+#define VABS(x)			_mm512_abs_pd(x)
+#define VDEINT(a, b, re, im)	do { \
+  re = _mm512_permutex2var_pd(a, _mm512_setr_epi64(0, 2, 4, 6, 8, 10, 12, \
+         14), b); \
+  im = _mm512_permutex2var_pd(a, _mm512_setr_epi64(1, 3, 5, 7, 9, 11, 13, \
+         15), b); } while (0)
+#define VINTL(re, im, a, b)	do { \
+  a = _mm512_permutex2var_pd(re, _mm512_setr_epi64(0, 8, 1, 9, 2, 10, 3, \
+        11), im); \
+  b = _mm512_permutex2var_pd(re, _mm512_setr_epi64(4, 12, 5, 13, 6, 14, 7, \
+        15), im); } while (0)
+#define VREV(x)			_mm512_permutexvar_pd(_mm512_setr_epi64(7, 6, \
+  5, 4, 3, 2, 1, 0), x)
+#endif
+
+#include "kernels_tmpl.h"
+
+#endif
+
+//=====================================================================
+
+#define SET_KERNELS(isa)			\
+  do						\
+  {						\
+    kern.magnitude = magnitude_##isa;		\
+    kern.window = window_##isa;			\
+    kern.mul = mul_##isa;			\
+    kern.mul_rev = mul_rev_##isa;		\
+    kern.mul_acc = mul_acc_##isa;		\
+    kern.dot = dot_##isa;			\
+    kern.abs_max = abs_max_##isa;		\
+    kern.scale = scale_##isa;			\
+    kern.add_scaled = add_scaled_##isa;		\
+    kern.mid_side = mid_side_##isa;		\
+    kern.resonate = resonate_##isa;		\
+  } while (0)
+
+//=====================================================================
+
+// returns the best instruction set supported by the processor (and the
+// operating system)
+
+static int32_t
+cpu_level(void)
+{
+#ifdef KERN_X86
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx512f"))
+    return KERN_AVX512;
+
+  if (__builtin_cpu_supports("avx2"))
+    return KERN_AVX2;
+
+  if (__builtin_cpu_supports("sse2"))
+    return KERN_SSE2;
+#endif
+
+  return KERN_SCALAR;
+}
+
+//=====================================================================
+
+char *
+kernels_name(int32_t level)
+{
+  if (level < KERN_AUTO || level > KERN_AVX512)
+    return "unknown";
+
+  return level_names[level];
+}
+
+//=====================================================================
+
+// selects the kernels for the given instruction set, or for the best one
+// available with KERN_AUTO. Returns 0 if the processor can't run them.
+
+int32_t
+kernels_init(int32_t level)
+{
+  int32_t best;
+
+  best = cpu_level();
+
+  if (level == KERN_AUTO)
+    level = best;
+  else if (level > best)
+    return 0;
+
+  switch (level)
+  {
+#ifdef KERN_X86
+    case KERN_AVX512:
+      SET_KERNELS(avx512);
+      break;
+
+    case KERN_AVX2:
+      SET_KERNELS(avx2);
+      break;
+
+    case KERN_SSE2:
+      SET_KERNELS(sse2);
+      break;
+#endif
+
+    default:
+      SET_KERNELS(scalar);
+      break;
+  }
+
+  message("DSP kernels: %s", level_names[level]);
+
+  return 1;
+}
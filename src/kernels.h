@@ -0,0 +1,43 @@
+/*
+  kernels.h - prototypes of the vectorised DSP kernels
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_KERNELS
+#define H_KERNELS
+
+enum { KERN_AUTO, KERN_SCALAR, KERN_SSE2, KERN_AVX2, KERN_AVX512 };
+
+// one set of kernels for every instruction set, selected at startup
+
+typedef struct
+{
+  void (*magnitude)(real *out, real *z, int32_t n);
+  void (*window)(real *z, real *re, real *im, real *w, int32_t n);
+  void (*mul)(real *out, real *a, real *b, int32_t n);
+  void (*mul_rev)(real *out, real *a, real *b, int32_t n);
+  void (*mul_acc)(real *out, real *a, real *b, int32_t n);
+  real (*dot)(real *a, real *b, int32_t n);
+  real (*abs_max)(real *x, int32_t n);
+  void (*scale)(real *x, int32_t n, real k);
+  void (*add_scaled)(real *out, real *a, int32_t n, real k);
+  void (*mid_side)(real *a, real *b, int32_t n);
+  void (*resonate)(real *y, real *p, real *pw, real *x, int32_t len,
+                   int32_t n, int32_t stages);
+} kernels_t;
+
+extern kernels_t kern;
+
+extern int32_t kernels_init(int32_t level);
+extern char *kernels_name(int32_t level);
+
+#endif
@@ -0,0 +1,327 @@
+/*
+  kernels_tmpl.h - DSP kernels, compiled once for every instruction set
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+// This file has no include guard, kernels.c includes it once per
+// instruction set after defining:
+//
+//   KFN(name)        name of the function for this instruction set
+//   KTARGET          target attribute of the functions
+//   VT, VL           vector type and number of samples it holds
+//   VLOAD, VSTORE    unaligned load and store
+//   VSET1            vector with all elements set to a value
+//   VADD, VMUL, VSQRT, VMAX, VABS
+//   VDEINT(a, b, re, im)   splits interleaved complex values
+//   VINTL(re, im, a, b)    interleaves them back
+//   VREV             reverses the order of the elements
+//
+// The vector loops are followed by scalar loops for the tails, with VL = 1
+// the vector loops alone give the plain C version.
+
+//=====================================================================
+
+// out[i] = |z[i]|, z holding n interleaved complex values
+
+static void KTARGET
+KFN(magnitude)(real *out, real *z, int32_t n)
+{
+  int32_t i;
+  VT a, b, re, im;
+
+  for (i = 0; i + VL <= n; i += VL)
+  {
+    a = VLOAD(&z[i * 2]);
+    b = VLOAD(&z[i * 2 + VL]);
+    VDEINT(a, b, re, im);
+    VSTORE(&out[i], VSQRT(VADD(VMUL(re, re), VMUL(im, im))));
+  }
+
+  for (; i < n; i++)
+    out[i] = sqrt(z[i * 2] * z[i * 2] + z[i * 2 + 1] * z[i * 2 + 1]);
+}
+
+//=====================================================================
+
+// windowed complex values: z[i] = (re[i] * w[i], im[-i] * w[i]),
+// the imaginary parts being read backwards
+
+static void KTARGET
+KFN(window)(real *z, real *re, real *im, real *w, int32_t n)
+{
+  int32_t i;
+  VT c, r, m, a, b;
+
+  for (i = 0; i + VL <= n; i += VL)
+  {
+    c = VLOAD(&w[i]);
+    r = VMUL(VLOAD(&re[i]), c);
+    m = VMUL(VREV(VLOAD(&im[-i - VL + 1])), c);
+    VINTL(r, m, a, b);
+    VSTORE(&z[i * 2], a);
+    VSTORE(&z[i * 2 + VL], b);
+  }
+
+  for (; i < n; i++)
+  {
+    z[i * 2] = re[i] * w[i];
+    z[i * 2 + 1] = im[-i] * w[i];
+  }
+}
+
+//=====================================================================
+
+// out[i] = a[i] * b[i]
+
+static void KTARGET
+KFN(mul)(real *out, real *a, real *b, int32_t n)
+{
+  int32_t i;
+
+  for (i = 0; i + VL <= n; i += VL)
+    VSTORE(&out[i], VMUL(VLOAD(&a[i]), VLOAD(&b[i])));
+
+  for (; i < n; i++)
+    out[i] = a[i] * b[i];
+}
+
+//=====================================================================
+
+// out[i] = a[i] * b[n - 1 - i]
+
+static void KTARGET
+KFN(mul_rev)(real *out, real *a, real *b, int32_t n)
+{
+  int32_t i;
+
+  for (i = 0; i + VL <= n; i += VL)
+    VSTORE(&out[i], VMUL(VLOAD(&a[i]), VREV(VLOAD(&b[n - i - VL]))));
+
+  for (; i < n; i++)
+    out[i] = a[i] * b[n - 1 - i];
+}
+
+//=====================================================================
+
+// out[i] += a[i] * b[i]
+
+static void KTARGET
+KFN(mul_acc)(real *out, real *a, real *b, int32_t n)
+{
+  int32_t i;
+
+  for (i = 0; i + VL <= n; i += VL)
+    VSTORE(&out[i], VADD(VLOAD(&out[i]), VMUL(VLOAD(&a[i]), VLOAD(&b[i]))));
+
+  for (; i < n; i++)
+    out[i] += a[i] * b[i];
+}
+
+//=====================================================================
+
+// returns the sum of a[i] * b[i]
+
+static real KTARGET
+KFN(dot)(real *a, real *b, int32_t n)
+{
+  int32_t i;
+  real t[VL], sum;
+  VT acc;
+
+  acc = VSET1(0.0);
+  for (i = 0; i + VL <= n; i += VL)
+    acc = VADD(acc, VMUL(VLOAD(&a[i]), VLOAD(&b[i])));
+
+  VSTORE(t, acc);
+  sum = 0.0;
+  for (i = 0; i < VL; i++)
+    sum += t[i];
+
+  for (i = n / VL * VL; i < n; i++)
+    sum += a[i] * b[i];
+
+  return sum;
+}
+
+//=====================================================================
+
+// returns the largest absolute value of x
+
+static real KTARGET
+KFN(abs_max)(real *x, int32_t n)
+{
+  int32_t i;
+  real t[VL], max;
+  VT acc;
+
+  acc = VSET1(0.0);
+  for (i = 0; i + VL <= n; i += VL)
+    acc = VMAX(acc, VABS(VLOAD(&x[i])));
+
+  VSTORE(t, acc);
+  max = 0.0;
+  for (i = 0; i < VL; i++)
+    if (t[i] > max)
+      max = t[i];
+
+  for (i = n / VL * VL; i < n; i++)
+    if (fabs(x[i]) > max)
+      max = fabs(x[i]);
+
+  return max;
+}
+
+//=====================================================================
+
+// x[i] *= k
+
+static void KTARGET
+KFN(scale)(real *x, int32_t n, real k)
+{
+  int32_t i;
+  VT c;
+
+  c = VSET1(k);
+  for (i = 0; i + VL <= n; i += VL)
+    VSTORE(&x[i], VMUL(VLOAD(&x[i]), c));
+
+  for (; i < n; i++)
+    x[i] *= k;
+}
+
+//=====================================================================
+
+// out[i] += a[i] * k
+
+static void KTARGET
+KFN(add_scaled)(real *out, real *a, int32_t n, real k)
+{
+  int32_t i;
+  VT c;
+
+  c = VSET1(k);
+  for (i = 0; i + VL <= n; i += VL)
+    VSTORE(&out[i], VADD(VLOAD(&out[i]), VMUL(VLOAD(&a[i]), c)));
+
+  for (; i < n; i++)
+    out[i] += a[i] * k;
+}
+
+//=====================================================================
+
+// (a[i], b[i]) = ((a[i] + b[i]) / 2, (a[i] - b[i]) / 2)
+
+static void KTARGET
+KFN(mid_side)(real *a, real *b, int32_t n)
+{
+  int32_t i;
+  real p, q;
+  VT x, y, h, mh;
+
+  h = VSET1(0.5);
+  mh = VSET1(-0.5);
+  for (i = 0; i + VL <= n; i += VL)
+  {
+    x = VMUL(VLOAD(&a[i]), h);
+    y = VLOAD(&b[i]);
+    VSTORE(&a[i], VADD(x, VMUL(y, h)));
+    VSTORE(&b[i], VADD(x, VMUL(y, mh)));
+  }
+
+  for (; i < n; i++)
+  {
+    p = a[i] * 0.5;
+    q = b[i];
+    a[i] = p + q * 0.5;
+    b[i] = p + q * -0.5;
+  }
+}
+
+// runs the len samples of x through n cascades of 'stages' complex
+// one-pole filters, every stage doing y = p * y + g * (its input), and
+// adds |y|^2 of the last stage to pw[i] at every sample. y holds the
+// real then the imaginary parts of the states of every stage (2 * stages
+// rows of n), p the real & imaginary parts of the poles, the imaginary
+// parts negated, and the gains (4 rows of n).
+
+static void KTARGET
+KFN(resonate)(real *y, real *p, real *pw, real *x, int32_t len, int32_t n,
+              int32_t stages)
+{
+  int32_t t, i, k;
+  real xr, xi, yr, yi;
+  VT v, zero, pr, pi, pn, g, ir, ii, sr, si;
+
+  zero = VSET1(0.0);
+  for (t = 0; t < len; t++)
+  {
+    v = VSET1(x[t]);
+    for (i = 0; i + VL <= n; i += VL)
+    {
+      pr = VLOAD(&p[i]);
+      pi = VLOAD(&p[n + i]);
+      pn = VLOAD(&p[2 * n + i]);
+      g = VLOAD(&p[3 * n + i]);
+      ir = v;
+      ii = zero;
+
+      for (k = 0; k < stages; k++)
+      {
+        sr = VLOAD(&y[2 * k * n + i]);
+        si = VLOAD(&y[(2 * k + 1) * n + i]);
+        ir = VADD(VADD(VMUL(pr, sr), VMUL(pn, si)), VMUL(g, ir));
+        ii = VADD(VADD(VMUL(pr, si), VMUL(pi, sr)), VMUL(g, ii));
+        VSTORE(&y[2 * k * n + i], ir);
+        VSTORE(&y[(2 * k + 1) * n + i], ii);
+      }
+
+      VSTORE(&pw[i], VADD(VLOAD(&pw[i]), VADD(VMUL(ir, ir), VMUL(ii, ii))));
+    }
+
+    for (; i < n; i++)
+    {
+      xr = x[t];
+      xi = 0.0;
+
+      for (k = 0; k < stages; k++)
+      {
+        yr = y[2 * k * n + i];
+        yi = y[(2 * k + 1) * n + i];
+        xr = p[i] * yr + p[2 * n + i] * yi + p[3 * n + i] * xr;
+        xi = p[i] * yi + p[n + i] * yr + p[3 * n + i] * xi;
+        y[2 * k * n + i] = xr;
+        y[(2 * k + 1) * n + i] = xi;
+      }
+
+      pw[i] += xr * xr + xi * xi;
+    }
+  }
+}
+
+//=====================================================================
+
+#undef KFN
+#undef KTARGET
+#undef VT
+#undef VL
+#undef VLOAD
+#undef VSTORE
+#undef VSET1
+#undef VADD
+#undef VMUL
+#undef VSQRT
+#undef VMAX
+#undef VABS
+#undef VDEINT
+#undef VINTL
+#undef VREV
+
@@ -0,0 +1,316 @@
+/*
+  live.c - real-time analysis of a sound as it arrives
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "kernels.h"
+#include "image.h"
+#include "dsp.h"
+#include "sound_io.h"
+#include "live.h"
+
+#define LIVE_STAGES	4	// one-pole filters in the cascade of a band
+
+#define PI		3.1415926535897932
+
+extern double logbase;
+
+// the bands analysed at one level of the pyramid, and the decimation
+// that feeds the next level
+
+typedef struct
+{
+  int32_t ib0, nb;	// first band & number of bands
+  real *y;		// filter states, 2 * LIVE_STAGES rows of nb
+  real *p;		// poles & gains, 4 rows of nb
+  real *pw;		// power of the bands summed over the column
+  int32_t count;	// samples summed in pw
+  real *dec;		// input samples the decimation still needs
+  int32_t len, c;	// their number & the centre of the next output
+  real *sig;		// samples of the level in this column
+} level_t;
+
+//=====================================================================
+
+// returns the pole radius of a cascade of LIVE_STAGES one-pole filters
+// whose response is at half power bw / 2 away from its centre, bw
+// relative to the rate
+
+static double
+pole_radius(double bw)
+{
+  double a, c;
+
+  a = 2.0 * (1.0 - cos(PI * bw));
+  c = pow(2.0, 1.0 / LIVE_STAGES) - 1.0;
+
+  return (2.0 * c + a - sqrt((2.0 * c + a) * (2.0 * c + a) - 4.0 * c * c)) /
+         (2.0 * c);
+}
+
+//=====================================================================
+
+// returns the delay (in samples of the input) that the decimations add
+// to level k, each one waiting for the taps after its centre
+
+static double
+decim_delay(int32_t k, int32_t ntaps)
+{
+  return (double) (ntaps - 1) * ((1 << k) - 1);
+}
+
+//=====================================================================
+
+// decimates the n samples of in by 2 with the halfband filter h, keeping
+// in the level what the next call still needs, and puts the outputs in
+// out. Returns their number.
+
+static int32_t
+decimate(level_t *l, real *in, int32_t n, real *h, int32_t ntaps, real *out)
+{
+  int32_t i, m, half, drop;
+  double sum;
+
+  half = ntaps / 2;
+  memcpy(&l->dec[l->len], in, n * sizeof(real));
+  l->len += n;
+
+  for (m = 0; l->c + ntaps - 1 < l->len; l->c += 2, m++)
+  {
+    sum = 0.5 * l->dec[l->c];
+    for (i = 0; i < ntaps; i++)
+      sum += h[i] * l->dec[l->c + 2 * (i - half) + 1];
+
+    out[m] = sum;
+  }
+
+  drop = l->c - ntaps;				// even, like c
+  memmove(l->dec, &l->dec[drop], (l->len - drop) * sizeof(real));
+  l->len -= drop;
+  l->c -= drop;
+
+  return m;
+}
+
+//=====================================================================
+
+// analyses the WAV stream wavfile (its header read) as it arrives, and
+// writes every column to outfile as soon as its samples are in: a byte
+// per band, from the highest band down, 255 being the full scale. Every
+// band is a cascade of complex one-pole filters as wide as the bands of
+// anal(), run at the lowest rate of the multirate pyramid that holds
+// it, its power averaged over the column. If latency (in samples) isn't
+// 0, the low bands are widened, or moved to higher rates, until neither
+// the filters nor the decimations delay them by more than the latency
+// less a column. The first channel is analysed, or the mix of all of
+// them. Returns 0 if the latency is too short.
+
+int32_t
+anal_live
+(
+  FILE *wavfile, FILE *outfile, int32_t channels, int32_t bits,
+  int32_t samplerate, int32_t bands, double bpo, double pixpersec,
+  double basefreq, double latency, double gamma, int32_t mix
+)
+{
+  int32_t ib, ic, j, k, n, m, nlev, ntaps, maxn, want, *level;
+  int64_t col, done, written;
+  real **sound, *h, *sig, *colbuf;
+  uint8_t *out;
+  double *freq, *rad, maxfreq, hop, lo, hi, budget, b, delay, worst;
+  level_t *lev, *l;
+  quant_t q;
+
+  freq = freqarray(basefreq, bands, bpo);
+  if (logbase == 1.0)
+    maxfreq = bpo;
+  else
+    maxfreq = basefreq * pow(logbase, ((double) (bands - 1) / bpo));
+
+  h = halfband_taps(&ntaps);
+  hop = 1.0 / pixpersec;
+
+  if (latency > 0.0 && latency - hop < LIVE_STAGES)
+  {
+    free(freq);
+    buf_free(h);
+    return 0;
+  }
+
+  // the level & the pole radius of every band, the deep levels given up
+  // when their decimations leave the filters too little of the latency
+
+  level = malloc(bands * sizeof(int32_t));
+  rad = malloc(bands * sizeof(double));
+  nlev = 1;
+  worst = 0.0;
+
+  for (ib = 0; ib < bands; ib++)
+  {
+    k = pyramid_level(log_pos((double) (ib + 1) / (double) (bands - 1),
+                              basefreq, maxfreq), pixpersec);
+
+    while (latency > 0.0 && k > 0 &&
+           latency - hop - decim_delay(k, ntaps) < LIVE_STAGES * (1 << k))
+      k--;
+
+    lo = log_pos((ib - 0.5) / (double) (bands - 1), basefreq, maxfreq);
+    hi = log_pos((ib + 0.5) / (double) (bands - 1), basefreq, maxfreq);
+    rad[ib] = pole_radius((hi - lo) * (1 << k));
+
+    if (latency > 0.0)
+    {
+      budget = latency - hop - decim_delay(k, ntaps);
+      b = budget / (LIVE_STAGES * (1 << k));
+      if (rad[ib] > b / (1.0 + b))
+        rad[ib] = b / (1.0 + b);
+    }
+
+    delay = hop + decim_delay(k, ntaps) +
+            LIVE_STAGES * rad[ib] / (1.0 - rad[ib]) * (1 << k);
+    if (delay > worst)
+      worst = delay;
+
+    level[ib] = k;
+    if (k + 1 > nlev)
+      nlev = k + 1;
+  }
+
+  message("Latency: %.3f s", worst / samplerate);
+
+  // the levels, from the input rate down, each one with its bands
+
+  maxn = (int32_t) ceil(hop) + 1;
+  lev = calloc(nlev, sizeof(level_t));
+
+  for (k = 0; k < nlev; k++)
+  {
+    l = &lev[k];
+    for (ib = bands - 1; ib >= 0 && level[ib] < k; ib--);
+    for (l->ib0 = ib + 1; l->ib0 > 0 && level[l->ib0 - 1] == k; l->ib0--);
+    l->nb = ib + 1 - l->ib0;
+
+    l->y = buf_calloc(2 * LIVE_STAGES * l->nb + 1);
+    l->p = buf_alloc(4 * l->nb + 1);
+    l->pw = buf_calloc(l->nb + 1);
+
+    for (j = 0; j < l->nb; j++)
+    {
+      ib = l->ib0 + j;
+      l->p[j] = rad[ib] * cos(2.0 * PI * freq[ib] * (1 << k));
+      l->p[l->nb + j] = rad[ib] * sin(2.0 * PI * freq[ib] * (1 << k));
+      l->p[2 * l->nb + j] = -l->p[l->nb + j];
+      l->p[3 * l->nb + j] = 1.0 - rad[ib];		// unity gain at the centre
+    }
+
+    l->dec = buf_calloc(2 * ntaps + maxn + 2);	// zeros before the start
+    l->len = l->c = ntaps;
+    l->sig = buf_alloc(maxn);
+  }
+
+  free(level);
+  free(rad);
+  free(freq);
+
+  sound = malloc(channels * sizeof(real *));
+  for (ic = 0; ic < channels; ic++)
+    sound[ic] = buf_alloc(maxn);
+
+  colbuf = buf_alloc(bands);
+  out = malloc(bands);
+  quant_init(&q, 1.0, 1.0 / gamma);
+
+  // a column at a time, each one as soon as its last sample is in
+
+  for (col = done = written = 0; ; col++)
+  {
+    want = (int32_t) (roundoff((col + 1) * hop) - done);
+    n = wav_read_part(wavfile, sound, want, channels, bits);
+    if (n == 0)
+      break;
+
+    done += n;
+    if (mix && channels > 1)
+      downmix(sound, channels, n);
+
+    for (k = 0, sig = sound[0], m = n; k < nlev; k++)
+    {
+      l = &lev[k];
+      if (l->nb > 0)
+        kern.resonate(l->y, l->p, l->pw, sig, m, l->nb, LIVE_STAGES);
+
+      l->count += m;
+
+      if (k + 1 < nlev)
+      {
+        m = decimate(l, sig, m, h, ntaps, lev[k + 1].sig);
+        sig = lev[k + 1].sig;
+      }
+    }
+
+    // the amplitudes, the envelope of a complex filter being half the
+    // amplitude of a real sine
+
+    for (k = 0; k < nlev; k++)
+    {
+      l = &lev[k];
+      for (j = 0; j < l->nb; j++)
+      {
+        colbuf[bands - 1 - (l->ib0 + j)] =
+          l->count > 0 ? 2.0 * sqrt(l->pw[j] / l->count) : 0.0;
+        l->pw[j] = 0.0;
+      }
+
+      l->count = 0;
+    }
+
+    quant_row(&q, out, colbuf, bands);
+    if (fwrite(out, 1, bands, outfile) != (size_t) bands)
+      break;
+
+    fflush(outfile);
+    written++;
+
+    if (n < want)
+      break;
+  }
+
+  message("Columns written: %.0f", (double) written);
+
+  for (k = 0; k < nlev; k++)
+  {
+    buf_free(lev[k].y);
+    buf_free(lev[k].p);
+    buf_free(lev[k].pw);
+    buf_free(lev[k].dec);
+    buf_free(lev[k].sig);
+  }
+
+  for (ic = 0; ic < channels; ic++)
+    buf_free(sound[ic]);
+
+  free(lev);
+  free(sound);
+  free(out);
+  buf_free(colbuf);
+  buf_free(h);
+
+  return 1;
+}
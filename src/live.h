@@ -0,0 +1,23 @@
+/*
+  live.h - prototypes of the real-time analysis functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_LIVE
+#define H_LIVE
+
+extern int32_t anal_live(FILE * wavfile, FILE * outfile, int32_t channels,
+			 int32_t bits, int32_t samplerate, int32_t bands,
+			 double bpo, double pixpersec, double basefreq,
+			 double latency, double gamma, int32_t mix);
+
+#endif
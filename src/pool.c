@@ -0,0 +1,348 @@
+/*
+  pool.c - thread pool with cost-aware work stealing
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "util.h"
+#include "pool.h"
+
+// The tasks are sorted by decreasing estimated cost and dealt to the
+// workers so that they all get about the same total cost (the most
+// expensive tasks first, each one to the least loaded worker). Every
+// worker runs its own tasks from the most expensive one down, and when
+// it has none left it steals the cheapest task of the worker with the
+// most work left, which evens out the errors of the cost estimate.
+
+typedef struct
+{
+  int32_t *task;		// task numbers, most expensive first
+  int32_t head, tail;		// the owner takes from the head, the
+  				// thieves from the tail
+  double left;			// estimated cost of the tasks left
+  mutex_t lock;
+} deque_t;
+
+typedef struct
+{
+  deque_t *dq;			// one task queue per worker
+  int32_t nthreads;
+  double *cost;
+  task_fn_t fn;
+  void *ctx;
+} pool_t;
+
+typedef struct
+{
+  pool_t *pool;
+  int32_t id;
+  int32_t started;		// 1 if a thread was created for the worker
+} worker_t;
+
+typedef struct
+{
+  double cost;
+  int32_t task;
+} order_t;			// what the tasks are sorted by, so that
+				// pools may run at the same time
+
+//=====================================================================
+
+#ifdef WIN32
+
+void
+mutex_init(mutex_t *m)
+{
+  InitializeCriticalSection(m);
+}
+
+void
+mutex_lock(mutex_t *m)
+{
+  EnterCriticalSection(m);
+}
+
+void
+mutex_unlock(mutex_t *m)
+{
+  LeaveCriticalSection(m);
+}
+
+void
+mutex_destroy(mutex_t *m)
+{
+  DeleteCriticalSection(m);
+}
+
+#else
+
+void
+mutex_init(mutex_t *m)
+{
+  pthread_mutex_init(m, NULL);
+}
+
+void
+mutex_lock(mutex_t *m)
+{
+  pthread_mutex_lock(m);
+}
+
+void
+mutex_unlock(mutex_t *m)
+{
+  pthread_mutex_unlock(m);
+}
+
+void
+mutex_destroy(mutex_t *m)
+{
+  pthread_mutex_destroy(m);
+}
+
+#endif
+
+//=====================================================================
+
+// takes a task from the head or the tail of a queue, returns -1 if the
+// queue is empty
+
+static int32_t
+take(pool_t *p, deque_t *d, int32_t from_tail)
+{
+  int32_t t;
+
+  t = -1;
+  mutex_lock(&d->lock);
+
+  if (d->head < d->tail)
+  {
+    if (from_tail)
+      t = d->task[--d->tail];
+    else
+      t = d->task[d->head++];
+
+    d->left -= p->cost[t];
+  }
+
+  mutex_unlock(&d->lock);
+
+  return t;
+}
+
+//=====================================================================
+
+// runs the tasks of worker 'id', then steals until no task is left
+
+static void
+work_loop(pool_t *p, int32_t id)
+{
+  int32_t i, t, victim;
+  double most;
+
+  while (1)
+  {
+    t = take(p, &p->dq[id], 0);
+
+    if (t < 0)
+    {
+      victim = -1;
+      most = 0.0;
+      for (i = 0; i < p->nthreads; i++)
+      {
+        if (i == id)
+          continue;
+
+        mutex_lock(&p->dq[i].lock);
+        if (p->dq[i].head < p->dq[i].tail &&
+            (victim < 0 || p->dq[i].left > most))
+        {
+          victim = i;
+          most = p->dq[i].left;
+        }
+        mutex_unlock(&p->dq[i].lock);
+      }
+
+      if (victim < 0)		// nothing left anywhere
+        return;
+
+      t = take(p, &p->dq[victim], 1);
+      if (t < 0)		// another thief was faster
+        continue;
+    }
+
+    p->fn(p->ctx, t, id);
+  }
+}
+
+//=====================================================================
+
+#ifdef WIN32
+static DWORD WINAPI
+thread_main(LPVOID arg)
+{
+  worker_t *w = (worker_t *) arg;
+
+  work_loop(w->pool, w->id);
+
+  return 0;
+}
+#else
+static void *
+thread_main(void *arg)
+{
+  worker_t *w = (worker_t *) arg;
+
+  work_loop(w->pool, w->id);
+
+  return NULL;
+}
+#endif
+
+//=====================================================================
+
+static int
+compare_cost(const void *a, const void *b)
+{
+  const order_t *oa = (const order_t *) a, *ob = (const order_t *) b;
+
+  if (oa->cost > ob->cost)
+    return -1;
+
+  if (oa->cost < ob->cost)
+    return 1;
+
+  return oa->task - ob->task;	// keep the order
+}
+
+//=====================================================================
+
+// runs fn() on the tasks 0 .. ntasks - 1 with nthreads workers, the
+// calling thread being one of them, and returns when all are done.
+// cost[] holds the estimated cost of each task, in any unit.
+
+void
+pool_run(int32_t ntasks, double *cost, task_fn_t fn, void *ctx,
+         int32_t nthreads)
+{
+  int32_t i, j, t, least;
+  order_t *order;
+  pool_t p;
+  worker_t *w;
+#ifdef WIN32
+  HANDLE *th;
+#else
+  pthread_t *th;
+#endif
+
+  if (nthreads > ntasks)
+    nthreads = ntasks;
+
+  if (nthreads <= 1)
+  {
+    for (i = 0; i < ntasks; i++)
+      fn(ctx, i, 0);
+
+    return;
+  }
+
+  order = malloc(ntasks * sizeof(order_t));
+  for (i = 0; i < ntasks; i++)
+  {
+    order[i].cost = cost[i];
+    order[i].task = i;
+  }
+
+  qsort(order, ntasks, sizeof(order_t), compare_cost);
+
+  p.nthreads = nthreads;
+  p.cost = cost;
+  p.fn = fn;
+  p.ctx = ctx;
+  p.dq = malloc(nthreads * sizeof(deque_t));
+
+  for (j = 0; j < nthreads; j++)
+  {
+    p.dq[j].task = malloc(ntasks * sizeof(int32_t));
+    p.dq[j].head = p.dq[j].tail = 0;
+    p.dq[j].left = 0.0;
+    mutex_init(&p.dq[j].lock);
+  }
+
+  // deal the tasks, the most expensive first, to the least loaded worker
+
+  for (i = 0; i < ntasks; i++)
+  {
+    least = 0;
+    for (j = 1; j < nthreads; j++)
+      if (p.dq[j].left < p.dq[least].left)
+        least = j;
+
+    t = order[i].task;
+    p.dq[least].task[p.dq[least].tail++] = t;
+    p.dq[least].left += cost[t];
+  }
+
+  w = malloc(nthreads * sizeof(worker_t));
+#ifdef WIN32
+  th = malloc(nthreads * sizeof(HANDLE));
+#else
+  th = malloc(nthreads * sizeof(pthread_t));
+#endif
+
+  for (j = 0; j < nthreads; j++)
+  {
+    w[j].pool = &p;
+    w[j].id = j;
+  }
+
+  // if a thread can't be created, its tasks are stolen by the others
+
+  for (j = 1; j < nthreads; j++)
+  {
+#ifdef WIN32
+    th[j] = CreateThread(NULL, 0, thread_main, &w[j], 0, NULL);
+    w[j].started = (th[j] != NULL);
+#else
+    w[j].started = (pthread_create(&th[j], NULL, thread_main, &w[j]) == 0);
+#endif
+  }
+
+  work_loop(&p, 0);		// the calling thread is worker 0
+
+  for (j = 1; j < nthreads; j++)
+  {
+    if (! w[j].started)
+      continue;
+
+#ifdef WIN32
+    WaitForSingleObject(th[j], INFINITE);
+    CloseHandle(th[j]);
+#else
+    pthread_join(th[j], NULL);
+#endif
+  }
+
+  for (j = 0; j < nthreads; j++)
+  {
+    mutex_destroy(&p.dq[j].lock);
+    free(p.dq[j].task);
+  }
+
+  free(p.dq);
+  free(w);
+  free(th);
+  free(order);
+}
@@ -0,0 +1,38 @@
+/*
+  pool.h - prototypes of the thread pool functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_POOL
+#define H_POOL
+
+#ifdef WIN32
+#include "Windows.h"
+typedef CRITICAL_SECTION mutex_t;
+#else
+#include <pthread.h>
+typedef pthread_mutex_t mutex_t;
+#endif
+
+// a task gets the shared context, its number and the number of the
+// worker running it (0 .. nthreads - 1), to pick per-thread buffers
+
+typedef void (*task_fn_t)(void *ctx, int32_t task, int32_t worker);
+
+extern void mutex_init(mutex_t *m);
+extern void mutex_lock(mutex_t *m);
+extern void mutex_unlock(mutex_t *m);
+extern void mutex_destroy(mutex_t *m);
+extern void pool_run(int32_t ntasks, double *cost, task_fn_t fn, void *ctx,
+                     int32_t nthreads);
+
+#endif
@@ -0,0 +1,317 @@
+/*
+  resample.c - polyphase resampling of the envelopes
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "kernels.h"
+#include "resample.h"
+
+#define BMSQ_LUT_SIZE		16000
+#define MAX_COEFS		(1 << 18)	// most coefficients kept by a
+						// resampler, larger ones
+						// compute them as they go
+
+#define PI			3.1415926535897932
+
+// Output sample i is at i * Mi / Mo in the input. Once reduced, this
+// ratio is step / period, so the position of output i + period is that
+// of output i moved by step input samples, and the period first outputs
+// (the phases) give the coefficients of all the others.
+
+//=====================================================================
+
+static int32_t
+gcd(int32_t a, int32_t b)
+{
+  int32_t t;
+
+  while (b != 0)
+  {
+    t = a % b;
+    a = b;
+    b = t;
+  }
+
+  return a;
+}
+
+//=====================================================================
+
+// floor(a / b) for b > 0
+
+static int64_t
+floor_div(int64_t a, int64_t b)
+{
+  return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+//=====================================================================
+
+// Blackman Square look-up table generator
+
+static real *
+bmsq_lut(int32_t size)
+{
+  int32_t i;			// general purpose iterator
+
+  real *lut;
+  double coef;			// Blackman square final coefficient
+  double bar = PI * (3.0 / (double) size) * (1.0 / 1.5);
+  double foo;
+
+  // Blackman Square coefficients
+  double f1  = -0.6595044010905501;
+  double f2  = 0.1601741366715479;
+  double f4  = -0.0010709178680006;
+  double f5  = 0.0001450093579222;
+  double f7  = 0.0001008528049040;
+  double f8  = 0.0000653092892874;
+  double f10 = 0.0000293385615146;
+  double f11 = 0.0000205351559060;
+  double f13 = 0.0000108567682890;
+  double f14 = 0.0000081549460136;
+  double f16 = 0.0000048519309366;
+  double f17 = 0.0000038284344102;
+  double f19 = 0.0000024753630724;
+
+  size++;			// allows to read value 3.0
+
+  lut = buf_calloc(size);
+
+  for (i = 0; i < size; i++)
+  {
+    foo = (double) i *bar;
+    coef = 0;
+
+    coef += cos(foo) * f1 - f1;
+    coef += cos(2.0 * foo) * f2 - f2;
+    coef += cos(4.0 * foo) * f4 - f4;
+    coef += cos(5.0 * foo) * f5 - f5;
+    coef += cos(7.0 * foo) * f7 - f7;
+    coef += cos(8.0 * foo) * f8 - f8;
+    coef += cos(10.0 * foo) * f10 - f10;
+    coef += cos(11.0 * foo) * f11 - f11;
+    coef += cos(13.0 * foo) * f13 - f13;
+    coef += cos(14.0 * foo) * f14 - f14;
+    coef += cos(16.0 * foo) * f16 - f16;
+    coef += cos(17.0 * foo) * f17 - f17;
+    coef += cos(19.0 * foo) * f19 - f19;
+
+    lut[i] = coef;
+  }
+
+  return lut;
+}
+
+//=====================================================================
+
+// computes the coefficients of phase p into c, the first input sample
+// they apply to (relative to the phase's own period) into first, and
+// returns their number
+
+static int32_t
+phase_coefs(resampler_t *r, int32_t p, real *c, int32_t *first)
+{
+  int32_t j, last, n, pos_luti;
+  int64_t num, Mi, Mo;
+  double x, ratio, coef, coef_sum, pos_lut, mod_pos, y0, y1, foo;
+
+  Mi = r->Mi;
+  Mo = r->Mo;
+  num = (int64_t) p * Mi;		// the position of the phase is num / Mo
+  n = 0;
+
+  if (r->kind == RESAMPLE_BLACKMAN)
+  {
+    // Blackman function over the input samples from pos - ratio to
+    // pos + ratio, normalised to a sum of 1
+
+    ratio = (double) Mi / Mo;
+    *first = (int32_t) -floor_div(Mi - num, Mo);	// ceil((num - Mi) / Mo)
+    last = (int32_t) floor_div(num + Mi, Mo);
+    coef_sum = 0.0;
+
+    for (j = *first; j <= last; j++)
+    {
+      x = (double) (j * Mo - num + Mi) / Mo;	// position within the Blackman function
+      coef = 0.42 - 0.5 * cos(PI * x / ratio) + 0.08 * cos(2 * PI * x / ratio);
+      coef_sum += coef;
+      c[n++] = coef;
+    }
+
+    for (j = 0; j < n; j++)
+      c[j] /= coef_sum;
+  }
+  else
+  {
+    // Blackman Square function over the 3 input samples around pos,
+    // read from the look-up table
+
+    foo = (double) BMSQ_LUT_SIZE / 3.0;
+    last = (int32_t) floor_div(2 * num + 3 * Mo, 2 * Mo);	// floor(pos + 1.5)
+    *first = last - 2;
+
+    for (j = *first; j <= last; j++)
+    {
+      x = (double) (2 * (j * Mo - num) + 3 * Mo) / (2 * Mo);	// in the
+      					// [0.0 ; 3.0] range
+      pos_lut = x * foo;
+      pos_luti = (int32_t) pos_lut;
+      if (pos_luti >= BMSQ_LUT_SIZE)
+        pos_luti = BMSQ_LUT_SIZE - 1;
+
+      mod_pos = pos_lut - pos_luti;	// modulo of the index
+
+      y0 = r->lut[pos_luti];		// interpolate linearly between the
+      					// two closest values
+      y1 = r->lut[pos_luti + 1];
+      coef = y0 + mod_pos * (y1 - y0);
+
+      c[n++] = coef;
+    }
+  }
+
+  return n;
+}
+
+//=====================================================================
+
+// creates a resampler from Mi to Mo samples, of one of these kinds:
+// RESAMPLE_BLACKMAN   downsampling by a Blackman function (Mi > Mo)
+// RESAMPLE_BMSQ       interpolation based on an estimate of the Blackman
+//                     Square function, which is a Blackman function
+//                     convolved with a square. It's like smoothing the
+//                     result of a nearest neighbour interpolation with a
+//                     Blackman FIR
+
+resampler_t *
+resample_new(int32_t Mi, int32_t Mo, int32_t kind)
+{
+  int32_t p, g;
+  resampler_t *r;
+
+  r = malloc(sizeof(resampler_t));
+  r->Mi = Mi;
+  r->Mo = Mo;
+  r->kind = kind;
+
+  g = gcd(Mi, Mo);
+  r->period = Mo / g;
+  r->step = Mi / g;
+
+  if (kind == RESAMPLE_BLACKMAN)
+    r->taps = (int32_t) (2.0 * Mi / Mo) + 3;
+  else
+    r->taps = 3;
+
+  r->lut = kind == RESAMPLE_BMSQ ? bmsq_lut(BMSQ_LUT_SIZE) : NULL;
+
+  if ((int64_t) r->period * r->taps > MAX_COEFS)
+  {
+    r->c = NULL;
+    r->first = r->count = NULL;
+    return r;
+  }
+
+  r->c = buf_alloc(r->period * r->taps);
+  r->first = malloc(r->period * sizeof(int32_t));
+  r->count = malloc(r->period * sizeof(int32_t));
+
+  for (p = 0; p < r->period; p++)
+    r->count[p] = phase_coefs(r, p, &r->c[p * r->taps], &r->first[p]);
+
+  return r;
+}
+
+//=====================================================================
+
+void
+resample_free(resampler_t *r)
+{
+  buf_free(r->c);
+  buf_free(r->lut);
+  free(r->first);
+  free(r->count);
+  free(r);
+}
+
+//=====================================================================
+
+// resamples in (Mi samples) to out (Mo samples). The input is taken as
+// zero outside of its bounds, the Blackman downsampling then only
+// weights the samples within them.
+
+void
+resample_run(resampler_t *r, real *in, real *out)
+{
+  int32_t i, j, p, j0, n, base;
+  real *c, *cp;
+  double sum;
+
+  c = r->c == NULL ? buf_alloc(r->taps) : NULL;
+
+  for (i = p = base = 0; i < r->Mo; i++)
+  {
+    if (r->c != NULL)
+    {
+      cp = &r->c[p * r->taps];
+      j0 = base + r->first[p];
+      n = r->count[p];
+    }
+    else
+    {
+      cp = c;
+      n = phase_coefs(r, p, c, &j0);
+      j0 += base;
+    }
+
+    if (j0 >= 0 && j0 + n <= r->Mi)
+      out[i] = kern.dot(&in[j0], cp, n);	// convolve
+    else
+    {
+      if (j0 < 0)			// only read the samples within bounds
+      {
+        cp -= j0;
+        n += j0;
+        j0 = 0;
+      }
+
+      if (j0 + n > r->Mi)
+        n = r->Mi - j0;
+
+      out[i] = n > 0 ? kern.dot(&in[j0], cp, n) : 0.0;
+
+      if (r->kind == RESAMPLE_BLACKMAN && n > 0)
+      {
+        for (j = 0, sum = 0.0; j < n; j++)
+          sum += cp[j];
+
+        out[i] /= sum;
+      }
+    }
+
+    if (++p == r->period)		// next period
+    {
+      p = 0;
+      base += r->step;
+    }
+  }
+
+  buf_free(c);
+}
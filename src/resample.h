@@ -0,0 +1,39 @@
+/*
+  resample.h - prototypes of the resampling functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_RESAMPLE
+#define H_RESAMPLE
+
+enum { RESAMPLE_BLACKMAN, RESAMPLE_BMSQ };
+
+// A resampler from Mi to Mo samples holds the coefficients of its
+// 'period' phases, 'taps' apart in c. Phase p is applied to the input
+// samples from first[p] on (count[p] of them), moved by 'step' samples
+// every period.
+
+typedef struct
+{
+  int32_t Mi, Mo, kind;
+  int32_t period, step;		// Mo and Mi divided by their GCD
+  int32_t taps;			// the most coefficients of a phase
+  int32_t *first, *count;	// the input samples of every phase
+  real *c;			// the coefficients, NULL if computed on demand
+  real *lut;			// Blackman Square look-up table
+} resampler_t;
+
+extern resampler_t *resample_new(int32_t Mi, int32_t Mo, int32_t kind);
+extern void resample_free(resampler_t *r);
+extern void resample_run(resampler_t *r, real *in, real *out);
+
+#endif
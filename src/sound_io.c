@@ -15,12 +15,14 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 
 #include "util.h"
+#include "buffer.h"
 #include "sound_io.h"
 
 void
-in_8(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+in_8(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
   uint8_t byte;
@@ -34,7 +36,7 @@ in_8(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
 }
 
 void
-out_8(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+out_8(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
   double val;
@@ -56,7 +58,7 @@ out_8(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
 }
 
 void
-in_16(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+in_16(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
 
@@ -66,7 +68,7 @@ in_16(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
 }
 
 void
-out_16(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+out_16(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
   double val;
@@ -85,7 +87,7 @@ out_16(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
 }
 
 void
-in_32(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+in_32(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
   float val;
@@ -99,7 +101,7 @@ in_32(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
 }
 
 void
-out_32(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
+out_32(FILE * wavfile, real **sound, int32_t samplecount, int32_t channels)
 {
   int32_t i, ic;
   float val;
@@ -112,13 +114,16 @@ out_32(FILE * wavfile, double **sound, int32_t samplecount, int32_t channels)
     }
 }
 
-double **
-wav_in(FILE * wavfile, int32_t * channels, int32_t * samplecount,
-       int32_t * samplerate)
+// reads the header of a WAV file and returns the number of bits per
+// sample, leaving the file at the start of the samples
+
+int32_t
+wav_open(FILE * wavfile, int32_t * channels, int32_t * samplecount,
+         int32_t * samplerate)
 {
-  int32_t i, ic;
-  double **sound;
+  int32_t i;
   int32_t tag[13];
+  uint32_t count;
 
   for (i = 0; i < 13; i++)	// tag reading
   {
@@ -147,29 +152,106 @@ wav_in(FILE * wavfile, int32_t * channels, int32_t * samplecount,
 
   *channels = tag[6];
 
-  *samplecount = tag[12] / (tag[10] / 8) / *channels;
+  // the size of the samples is unsigned, up to 4 GiB, but a sample
+  // number must fit an int32_t
+  count = (uint32_t) tag[12] / (tag[10] / 8) / *channels;
+  if (count > INT32_MAX)
+  {
+    message("Warning: only the first %d samples of this WAVE file can be "
+            "read.", INT32_MAX);
+    count = INT32_MAX;
+  }
+
+  *samplecount = (int32_t) count;
   *samplerate = tag[7];
 
-  sound = malloc(*channels * sizeof(double *));	// allocate sound
-  for (ic = 0; ic < *channels; ic++)
-    sound[ic] = malloc(*samplecount * sizeof(double));
+  return tag[10];
+}
 
-  //********Data loading********
+// positions an open WAV file at sample 'first' of its channels, the
+// samples following the 44 bytes of the header read by wav_open()
+
+void
+wav_seek(FILE * wavfile, int32_t first, int32_t channels, int32_t bits)
+{
+  file_seek(wavfile, 44 + (int64_t) first * channels * (bits / 8));
+}
+
+// reads the next samplecount samples of every channel of an open WAV
+// file with 'bits' bits per sample
+
+void
+wav_read(FILE * wavfile, real **sound, int32_t samplecount,
+         int32_t channels, int32_t bits)
+{
+  if (bits == 8)
+    in_8(wavfile, sound, samplecount, channels);
+  if (bits == 16)
+    in_16(wavfile, sound, samplecount, channels);
+  if (bits == 32)
+    in_32(wavfile, sound, samplecount, channels);
+}
+
+// reads up to samplecount samples of every channel of an open WAV
+// stream like wav_read(), but stops at the end of the input, which a
+// pipe may reach before the length its header gives. Returns the number
+// of samples read.
+
+int32_t
+wav_read_part(FILE * wavfile, real **sound, int32_t samplecount,
+              int32_t channels, int32_t bits)
+{
+  int32_t i, ic, n, size;
+  uint8_t *b, *p;
+  uint32_t w;
+  float val;
+
+  size = channels * (bits / 8);
+  b = malloc((size_t) samplecount * size);
+  n = fread(b, size, samplecount, wavfile);
+
+  for (i = 0, p = b; i < n; i++)
+    for (ic = 0; ic < channels; ic++, p += bits / 8)
+    {
+      if (bits == 8)
+        sound[ic][i] = (double) p[0] / 128.0 - 1.0;
+      if (bits == 16)
+        sound[ic][i] = (double) ((int16_t) (p[0] | (p[1] << 8))) / 32768.0;
+      if (bits == 32)
+      {
+        w = (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+            ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+        memcpy(&val, &w, sizeof(float));
+        sound[ic][i] = (double) val;
+      }
+    }
+
+  free(b);
+
+  return n;
+}
+
+real **
+wav_in(FILE * wavfile, int32_t * channels, int32_t * samplecount,
+       int32_t * samplerate)
+{
+  int32_t ic, bits;
+  real **sound;
+
+  bits = wav_open(wavfile, channels, samplecount, samplerate);
+
+  sound = malloc(*channels * sizeof(real *));	// allocate sound
+  for (ic = 0; ic < *channels; ic++)
+    sound[ic] = buf_alloc(*samplecount);
 
-  if (tag[10] == 8)
-    in_8(wavfile, sound, *samplecount, *channels);
-  if (tag[10] == 16)
-    in_16(wavfile, sound, *samplecount, *channels);
-  if (tag[10] == 32)
-    in_32(wavfile, sound, *samplecount, *channels);
-  //--------Data loading--------
+  wav_read(wavfile, sound, *samplecount, *channels, bits);	// Data loading
 
   fclose(wavfile);
   return sound;
 }
 
 void
-wav_out(FILE * wavfile, double **sound, int32_t channels,
+wav_out(FILE * wavfile, real **sound, int32_t channels,
 	int32_t samplecount, int32_t samplerate, int32_t format_param)
 {
   int32_t i;
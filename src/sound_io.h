@@ -15,21 +15,30 @@
 #ifndef H_SOUND_IO
 #define H_SOUND_IO
 
-extern void in_8(FILE * wavfile, double **sound, int32_t samplecount,
+extern void in_8(FILE * wavfile, real **sound, int32_t samplecount,
 		 int32_t channels);
-extern void out_8(FILE * wavfile, double **sound, int32_t samplecount,
+extern void out_8(FILE * wavfile, real **sound, int32_t samplecount,
 		  int32_t channels);
-extern void in_16(FILE * wavfile, double **sound, int32_t samplecount,
+extern void in_16(FILE * wavfile, real **sound, int32_t samplecount,
 		  int32_t channels);
-extern void out_16(FILE * wavfile, double **sound, int32_t samplecount,
+extern void out_16(FILE * wavfile, real **sound, int32_t samplecount,
 		   int32_t channels);
-extern void in_32(FILE * wavfile, double **sound, int32_t samplecount,
+extern void in_32(FILE * wavfile, real **sound, int32_t samplecount,
 		  int32_t channels);
-extern void out_32(FILE * wavfile, double **sound, int32_t samplecount,
+extern void out_32(FILE * wavfile, real **sound, int32_t samplecount,
 		   int32_t channels);
-extern double **wav_in(FILE * wavfile, int32_t * channels,
+extern int32_t wav_open(FILE * wavfile, int32_t * channels,
 		       int32_t * samplecount, int32_t * samplerate);
-extern void wav_out(FILE * wavfile, double **sound, int32_t channels,
+extern void wav_seek(FILE * wavfile, int32_t first, int32_t channels,
+		     int32_t bits);
+extern void wav_read(FILE * wavfile, real **sound, int32_t samplecount,
+		     int32_t channels, int32_t bits);
+extern int32_t wav_read_part(FILE * wavfile, real **sound,
+			     int32_t samplecount, int32_t channels,
+			     int32_t bits);
+extern real **wav_in(FILE * wavfile, int32_t * channels,
+		       int32_t * samplecount, int32_t * samplerate);
+extern void wav_out(FILE * wavfile, real **sound, int32_t channels,
 		    int32_t samplecount, int32_t samplerate,
 		    int32_t format_param);
 
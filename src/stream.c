@@ -0,0 +1,810 @@
+/*
+  stream.c - analysis of sounds of any length in bounded memory
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "util.h"
+#include "buffer.h"
+#include "kernels.h"
+#include "pool.h"
+#include "image.h"
+#include "dsp.h"
+#include "sound_io.h"
+#include "image_io.h"
+#include "stream.h"
+
+extern int32_t threads;
+extern int32_t freq_decim;
+extern int32_t multirate;
+extern double logbase;
+
+// The sound is read in blocks of columns, never as a whole. Every block
+// is analysed on its own with 'margin' columns of the signal on either
+// side for the band filters to settle, and only its own columns are
+// kept (overlap-save, done by every band of the filter bank at once), so
+// only the samples of the blocks being analysed are in memory, one
+// block per thread. As the image is normalised to its global maximum,
+// which is only known at the end, the columns first go unscaled to a
+// temporary file, then are read back one block at a time, scaled and
+// written to their place in the BMP file.
+
+typedef struct
+{
+  real *s;			// the samples of the round, from 'first' on
+  int32_t first, samplecount;
+  int32_t x0, Xsize;		// first column of the round & of the image
+  int32_t blk_cols, margin;
+  int32_t nround;		// blocks analysed at a time
+  int32_t bands;
+  image_t **img;		// the columns of every block of the round
+  double *max;			// the largest value of every block
+  double bpo, pixpersec, basefreq;
+} stream_ctx_t;
+
+//=====================================================================
+
+// returns the columns of block 'task' of the round
+
+static int32_t
+block_cols(stream_ctx_t *c, int32_t task, int32_t *x0)
+{
+  *x0 = c->x0 + task * c->blk_cols;
+
+  if (*x0 + c->blk_cols > c->Xsize)
+    return c->Xsize - *x0;
+
+  return c->blk_cols;
+}
+
+//=====================================================================
+
+static void
+stream_block(void *ctx, int32_t task, int32_t worker)
+{
+  stream_ctx_t *c = (stream_ctx_t *) ctx;
+  int32_t x0, n;
+
+  n = block_cols(c, task, &x0);
+
+  c->max[task] = anal_block(c->s, c->first, c->samplecount, x0, x0 + n,
+                            c->margin, c->img[task], 0, c->bpo,
+                            c->pixpersec, c->basefreq);
+}
+
+//=====================================================================
+
+// sets up the blocks of blk_len seconds of the analysis of samplecount
+// samples
+
+static void
+stream_init
+(
+  stream_ctx_t *c, int32_t samplecount, int32_t samplerate, int32_t bands,
+  double bpo, double pixpersec, double basefreq, double blk_len
+)
+{
+  int32_t i, nblk;
+
+  c->Xsize = anal_width(samplecount, pixpersec);
+  message("Image size: %d(W)x%d(H)", c->Xsize, bands);
+
+  c->blk_cols = roundoff(blk_len * samplerate * pixpersec);
+  if (c->blk_cols < 1)
+    c->blk_cols = 1;
+
+  nblk = (c->Xsize + c->blk_cols - 1) / c->blk_cols;
+  c->nround = threads < nblk ? threads : nblk;
+
+  c->samplecount = samplecount;
+  c->bands = bands;
+  c->margin = anal_margin(bands, bpo, pixpersec, basefreq);
+  c->bpo = bpo;
+  c->pixpersec = pixpersec;
+  c->basefreq = basefreq;
+
+  c->img = malloc(c->nround * sizeof(image_t *));
+  for (i = 0; i < c->nround; i++)
+    c->img[i] = image_new(c->blk_cols, bands, IMAGE_REAL);
+
+  c->max = malloc(c->nround * sizeof(double));
+}
+
+//=====================================================================
+
+static void
+stream_free(stream_ctx_t *c)
+{
+  int32_t i;
+
+  for (i = 0; i < c->nround; i++)
+    image_free(c->img[i]);
+
+  free(c->img);
+  free(c->max);
+}
+
+//=====================================================================
+
+// pass 1: analyses the columns x_start .. of the image, 'nround' blocks
+// at a time, keeping only the samples they need, and stores them in tmp
+// block after block. x_start is the first column of a block, and
+// wavfile is at the first sample the block needs. Returns the largest
+// value, and raises max_final (if not NULL) to the largest value of the
+// blocks before column x_final.
+
+static double
+stream_anal
+(
+  stream_ctx_t *c, FILE *wavfile, int32_t channels, int32_t bits,
+  int32_t x_start, FILE *tmp, int32_t x_final, double *max_final
+)
+{
+  int32_t i, ib, ic, have, a, b, x1, n;
+  real **sound, *scratch;
+  double *cost, max;
+
+  cost = malloc(c->nround * sizeof(double));
+  for (i = 0; i < c->nround; i++)
+    cost[i] = 1.0;
+
+  message("Analysing in %d blocks",
+          (c->Xsize - x_start + c->blk_cols - 1) / c->blk_cols);
+
+  sound = malloc(channels * sizeof(real *));
+  scratch = NULL;
+  c->s = NULL;
+  anal_span(x_start, x_start + 1, c->margin, c->samplecount, c->pixpersec,
+            &c->first, &b);
+  have = c->first;
+  max = 0.0;
+
+  for (c->x0 = x_start; c->x0 < c->Xsize; c->x0 = x1)
+  {
+    x1 = c->x0 + c->nround * c->blk_cols;
+    if (x1 > c->Xsize)
+      x1 = c->Xsize;
+
+    anal_span(c->x0, x1, c->margin, c->samplecount, c->pixpersec, &a, &b);
+
+    if (a > have)			// the samples are read in order
+      a = have;
+
+    // drop the samples before a, read those up to b
+
+    if (a > c->first)
+    {
+      memmove(c->s, &c->s[a - c->first], (have - a) * sizeof(real));
+      c->first = a;
+    }
+
+    if (b > have)
+    {
+      c->s = buf_resize(c->s, b - c->first);
+      scratch = buf_resize(scratch, b - have);
+
+      sound[0] = &c->s[have - c->first];
+      for (ic = 1; ic < channels; ic++)	// the other channels are skipped
+        sound[ic] = scratch;
+
+      wav_read(wavfile, sound, b - have, channels, bits);
+      have = b;
+    }
+
+    pool_run((x1 - c->x0 + c->blk_cols - 1) / c->blk_cols, cost,
+             stream_block, c, threads);
+
+    for (i = 0; c->x0 + i * c->blk_cols < x1; i++)
+    {
+      n = block_cols(c, i, &a);
+
+      if (c->max[i] > max)
+        max = c->max[i];
+
+      if (max_final != NULL && a < x_final && c->max[i] > *max_final)
+        *max_final = c->max[i];
+
+      for (ib = 0; ib < c->bands; ib++)
+        fwrite(image_row(c->img[i], ib), sizeof(real), n, tmp);
+    }
+  }
+
+  free(cost);
+  free(sound);
+  buf_free(scratch);
+  buf_free(c->s);
+
+  return max;
+}
+
+//=====================================================================
+
+// pass 2: reads back the columns stored by stream_anal(), block by
+// block, and puts them into the image, quantised by q
+
+static void
+stream_write
+(
+  stream_ctx_t *c, FILE *tmp, FILE *bmpfile, int32_t x_start, quant_t *q
+)
+{
+  int32_t a, ib, n;
+  real *row;
+
+  rewind(tmp);
+
+  for (a = x_start; a < c->Xsize; a += c->blk_cols)
+  {
+    n = c->Xsize - a < c->blk_cols ? c->Xsize - a : c->blk_cols;
+
+    for (ib = 0; ib < c->bands; ib++)
+    {
+      row = image_row(c->img[0], ib);
+      if (fread(row, sizeof(real), n, tmp) != n)
+        memset(row, 0, n * sizeof(real));
+    }
+
+    bmp_put_columns(bmpfile, c->img[0], c->Xsize, a, n, q);
+  }
+}
+
+//=====================================================================
+
+// analyses the sound of wavfile, positioned by wav_open() at its first
+// sample, in blocks of blk_len seconds (of the first channel only, like
+// anal()), and writes the spectrogram to bmpfile. Returns 0 if the
+// temporary file can't be created, 1 otherwise.
+
+int32_t
+anal_stream
+(
+  FILE *wavfile, FILE *bmpfile, int32_t channels, int32_t samplecount,
+  int32_t bits, int32_t samplerate, int32_t bands, double bpo,
+  double pixpersec, double basefreq, double blk_len, double gamma
+)
+{
+  double max;
+  FILE *tmp;
+  quant_t q;
+  stream_ctx_t c;
+
+  tmp = tmpfile();
+  if (tmp == NULL)
+    return 0;
+
+  stream_init(&c, samplecount, samplerate, bands, bpo, pixpersec, basefreq,
+              blk_len);
+
+  max = stream_anal(&c, wavfile, channels, bits, 0, tmp, 0, NULL);
+
+  quant_init(&q, max, 1.0 / gamma);
+  bmp_create(bmpfile, bands, c.Xsize);
+  stream_write(&c, tmp, bmpfile, 0, &q);
+
+  fclose(tmp);
+  stream_free(&c);
+
+  return 1;
+}
+
+//=====================================================================
+
+// An image made with anal_append() has a state file next to it, holding
+// what is needed to extend it as its sound grows: how far the analysis
+// went, the largest value that the image is normalised to, the largest
+// value of its final columns, and the parameters, which must stay the
+// same. The columns of a block are final once the block is whole and
+// every sample its margins need was there, so a refresh starts at the
+// first block that wasn't final, reads the sound from the first sample
+// that block needs, widens the image in place and writes the columns
+// from there on, normalised like the others. The largest value of the
+// image is then that of the final columns or of the new ones, and should
+// it differ from the one the image is normalised to (the new columns
+// being louder, or the loudest ones having changed as their sound grew),
+// the whole image is analysed again, as all of it has to be normalised
+// anew.
+
+enum
+{
+  ST_SAMPLES, ST_COLUMNS, ST_FINAL, ST_MAX, ST_FINAL_MAX,	// the progress
+  ST_BANDS, ST_BPO, ST_PPS, ST_BASEFREQ, ST_GAMMA,	// the parameters
+  ST_BLOCK, ST_RATE, ST_LOGBASE, ST_MULTIRATE, ST_DECIM,
+  ST_COUNT
+};
+
+#define ST_PARAMS	ST_BANDS	// the first parameter
+
+static char *state_keys[ST_COUNT] =
+{
+  "Samples", "Columns", "Final", "Max", "FinalMax", "Bands", "BandPerOct", "PixPerSec",
+  "MinFreq", "Gamma", "Block", "Rate", "LogBase", "Multirate", "FreqDecim"
+};
+
+//=====================================================================
+
+// reads the state file 'name' into st, returns 0 if it isn't complete
+
+static int32_t
+state_read(char *name, double *st)
+{
+  int32_t i, found;
+  char line[256], key[64];
+  double v;
+  FILE *f;
+
+  f = fopen(name, "r");
+  if (f == NULL)
+    return 0;
+
+  found = 0;
+  while (fgets(line, sizeof(line), f) != NULL)
+  {
+    if (line[0] == '#' || sscanf(line, "%63s %lf", key, &v) != 2)
+      continue;
+
+    for (i = 0; i < ST_COUNT; i++)
+      if (strcmp(key, state_keys[i]) == 0)
+      {
+        st[i] = v;
+        found |= 1 << i;
+      }
+  }
+
+  fclose(f);
+
+  return found == (1 << ST_COUNT) - 1;
+}
+
+//=====================================================================
+
+// writes st to the state file 'name', returns 0 if it can't be created
+
+static int32_t
+state_write(char *name, double *st)
+{
+  int32_t i;
+  FILE *f;
+
+  f = fopen(name, "w");
+  if (f == NULL)
+    return 0;
+
+  fprintf(f, "# ASPERES append state, keep it next to its image\n");
+  for (i = 0; i < ST_COUNT; i++)
+    fprintf(f, "%-12s%.17g\n", state_keys[i], st[i]);
+
+  fclose(f);
+
+  return 1;
+}
+
+//=====================================================================
+
+// returns the first column of the first block of the image that isn't
+// final, the image being analysed up to its last sample
+
+static int32_t
+first_open_column(stream_ctx_t *c)
+{
+  int32_t x0, a, b;
+
+  for (x0 = 0; x0 + c->blk_cols <= c->Xsize; x0 += c->blk_cols)
+  {
+    anal_span(x0, x0 + c->blk_cols, c->margin, INT32_MAX, c->pixpersec,
+              &a, &b);
+    if (b > c->samplecount)
+      break;
+  }
+
+  return x0;
+}
+
+//=====================================================================
+
+// analyses the sound of wavfile like anal_stream() into the image
+// bmpname, and only what it hasn't analysed before if the image is the
+// spectrogram of the start of the same sound, made by anal_append() with
+// the same parameters. Returns 0 if a file can't be created, 1
+// otherwise.
+
+int32_t
+anal_append
+(
+  FILE *wavfile, char *bmpname, int32_t channels, int32_t samplecount,
+  int32_t bits, int32_t samplerate, int32_t bands, double bpo,
+  double pixpersec, double basefreq, double blk_len, double gamma
+)
+{
+  int32_t i, x_start, a, b, ok;
+  double st[ST_COUNT], old[ST_COUNT], max;
+  char *name;
+  FILE *bmpfile, *tmp;
+  quant_t q;
+  stream_ctx_t c;
+
+  tmp = tmpfile();
+  if (tmp == NULL)
+    return 0;
+
+  name = malloc(strlen(bmpname) + 7);
+  sprintf(name, "%s.state", bmpname);
+
+  stream_init(&c, samplecount, samplerate, bands, bpo, pixpersec, basefreq,
+              blk_len);
+
+  st[ST_SAMPLES] = samplecount;
+  st[ST_COLUMNS] = c.Xsize;
+  st[ST_FINAL] = first_open_column(&c);
+  st[ST_BANDS] = bands;
+  st[ST_BPO] = bpo;
+  st[ST_PPS] = pixpersec;
+  st[ST_BASEFREQ] = basefreq;
+  st[ST_GAMMA] = gamma;
+  st[ST_BLOCK] = c.blk_cols;
+  st[ST_RATE] = samplerate;
+  st[ST_LOGBASE] = logbase;
+  st[ST_MULTIRATE] = multirate;
+  st[ST_DECIM] = freq_decim;
+
+  // the image can be extended if it was made from fewer samples with
+  // the same parameters
+
+  ok = state_read(name, old) && old[ST_SAMPLES] <= samplecount;
+  for (i = ST_PARAMS; ok && i < ST_COUNT; i++)
+    if (old[i] != st[i])
+      ok = 0;
+
+  bmpfile = ok ? fopen(bmpname, "r+b") : NULL;
+  max = 0.0;
+
+  if (bmpfile != NULL && old[ST_SAMPLES] == samplecount)
+  {
+    message("The image is up to date");
+    st[ST_MAX] = old[ST_MAX];
+    st[ST_FINAL_MAX] = old[ST_FINAL_MAX];
+  }
+  else if (bmpfile != NULL)
+  {
+    x_start = (int32_t) old[ST_FINAL];
+    message("Extending the image from column %d", x_start);
+
+    anal_span(x_start, x_start + 1, c.margin, samplecount, pixpersec, &a,
+              &b);
+    wav_seek(wavfile, a, channels, bits);
+    st[ST_FINAL_MAX] = old[ST_FINAL_MAX];
+    max = stream_anal(&c, wavfile, channels, bits, x_start, tmp,
+                      (int32_t) st[ST_FINAL], &st[ST_FINAL_MAX]);
+    if (max < old[ST_FINAL_MAX])
+      max = old[ST_FINAL_MAX];
+
+    if (max == old[ST_MAX])
+    {
+      st[ST_MAX] = old[ST_MAX];
+      quant_init(&q, st[ST_MAX], 1.0 / gamma);
+      bmp_widen(bmpfile, bands, (int32_t) old[ST_COLUMNS], c.Xsize);
+      stream_write(&c, tmp, bmpfile, x_start, &q);
+    }
+    else
+    {
+      message("The largest value changed, analysing it all again");
+      fclose(bmpfile);
+      bmpfile = NULL;
+      rewind(tmp);
+    }
+  }
+
+  if (bmpfile == NULL)			// from scratch
+  {
+    bmpfile = fopen(bmpname, "wb");
+    if (bmpfile == NULL)
+    {
+      stream_free(&c);
+      fclose(tmp);
+      free(name);
+      return 0;
+    }
+
+    wav_seek(wavfile, 0, channels, bits);
+    st[ST_FINAL_MAX] = 0.0;
+    st[ST_MAX] = stream_anal(&c, wavfile, channels, bits, 0, tmp,
+                             (int32_t) st[ST_FINAL], &st[ST_FINAL_MAX]);
+
+    quant_init(&q, st[ST_MAX], 1.0 / gamma);
+    bmp_create(bmpfile, bands, c.Xsize);
+    stream_write(&c, tmp, bmpfile, 0, &q);
+  }
+
+  fclose(bmpfile);
+  fclose(tmp);
+  stream_free(&c);
+
+  ok = state_write(name, st);
+  free(name);
+
+  return ok;
+}
+
+//=====================================================================
+
+// The rows of an image are its bands, which the analysis finishes one
+// at a time in any order. Each of them goes to its place in a temporary
+// file as soon as it is done, while the other bands are still being
+// worked on, and the image is never held as a whole. Once the last one
+// is done the maximum is known, and the rows are read back one by one,
+// normalised and quantised into the image, from its bottom row up like
+// the BMP file itself.
+
+typedef struct
+{
+  FILE *tmp;
+  int32_t Xsize;
+  double max;			// of the rows done so far
+  mutex_t lock;
+} pipe_ctx_t;
+
+//=====================================================================
+
+static void
+pipe_row(void *ctx, int32_t iy, real *row)
+{
+  pipe_ctx_t *c = (pipe_ctx_t *) ctx;
+  double m;
+
+  m = kern.abs_max(row, c->Xsize);
+
+  mutex_lock(&c->lock);
+
+  if (m > c->max)
+    c->max = m;
+
+  file_seek(c->tmp, (int64_t) iy * c->Xsize * sizeof(real));
+  fwrite(row, sizeof(real), c->Xsize, c->tmp);
+
+  mutex_unlock(&c->lock);
+}
+
+//=====================================================================
+
+// analyses the sound s (samplecount samples, freed) like anal() and
+// writes its spectrogram to bmpfile a row at a time as the bands are
+// done. Returns 0 if the temporary file can't be created, 1 otherwise.
+
+int32_t
+anal_pipe
+(
+  real *s, int32_t samplecount, FILE *bmpfile, int32_t bands, double bpo,
+  double pixpersec, double basefreq, double gamma
+)
+{
+  int32_t iy;
+  image_t *line;
+  real *row;
+  quant_t q;
+  pipe_ctx_t c;
+
+  c.tmp = tmpfile();
+  if (c.tmp == NULL)
+    return 0;
+
+  c.Xsize = anal_width(samplecount, pixpersec);
+  c.max = 0.0;
+  mutex_init(&c.lock);
+
+  anal_rows(s, samplecount, bands, bpo, pixpersec, basefreq, pipe_row, &c);
+
+  mutex_destroy(&c.lock);
+
+  quant_init(&q, c.max, 1.0 / gamma);
+
+  line = image_new(c.Xsize, 1, IMAGE_REAL);
+  row = image_row(line, 0);
+  bmp_create(bmpfile, bands, c.Xsize);
+
+  for (iy = bands - 1; iy >= 0; iy--)
+  {
+    file_seek(c.tmp, (int64_t) iy * c.Xsize * sizeof(real));
+    if (fread(row, sizeof(real), c.Xsize, c.tmp) != c.Xsize)
+      memset(row, 0, c.Xsize * sizeof(real));
+
+    bmp_put_row(bmpfile, line, bands, iy, &q);
+  }
+
+  image_free(line);
+  fclose(c.tmp);
+
+  return 1;
+}
+
+//=====================================================================
+
+// A pyramid of tiles holds the spectrogram at every zoom level without
+// the image itself ever being held or written: level 0 has its columns,
+// every level above it half as many, each one the largest or the mean of
+// two of the level below, down to a level no wider than a tile. Every
+// level is cut into tiles of TILE_SIZE x TILE_SIZE bytes, each tile row
+// by row from its top, which are stored one after the other in a single
+// file: level by level, every level a row of tiles after the other. A
+// band is pooled to every level as soon as it is done and its pixels
+// written straight into their tiles, the largest value of the image
+// having been found by a first pass. An index file next to the tiles
+// gives their size and the place of every level, so a viewer can read
+// any tile of any level on its own.
+
+#define TILE_SIZE	256
+#define MAX_TILE_LEVELS	32
+
+typedef struct
+{
+  FILE *f;
+  int32_t nlev, pool, down;	// levels, pooling & tiles down every level
+  int32_t width[MAX_TILE_LEVELS];	// columns of every level
+  int32_t across[MAX_TILE_LEVELS];	// & its tiles across
+  int64_t base[MAX_TILE_LEVELS];	// where its first tile is
+  quant_t *q;
+  mutex_t lock;
+} tile_ctx_t;
+
+//=====================================================================
+
+// pools the n values of a in pairs into its first (n + 1) / 2 values
+
+static void
+pool_pairs(real *a, int32_t n, int32_t pool)
+{
+  int32_t i;
+
+  for (i = 0; 2 * i + 1 < n; i++)
+    if (pool == POOL_MAX)
+      a[i] = a[2 * i] > a[2 * i + 1] ? a[2 * i] : a[2 * i + 1];
+    else
+      a[i] = (a[2 * i] + a[2 * i + 1]) * 0.5;
+
+  if (n % 2 == 1)
+    a[i] = a[2 * i];
+}
+
+//=====================================================================
+
+static void
+tile_row(void *ctx, int32_t iy, real *row)
+{
+  tile_ctx_t *c = (tile_ctx_t *) ctx;
+  int32_t l, tx;
+  int64_t pos;
+  real *a;
+  uint8_t *line;
+
+  a = buf_alloc(c->width[0]);
+  memcpy(a, row, c->width[0] * sizeof(real));
+  line = malloc(c->across[0] * TILE_SIZE);
+
+  for (l = 0; l < c->nlev; l++)
+  {
+    if (l > 0)
+      pool_pairs(a, c->width[l - 1], c->pool);
+
+    quant_row(c->q, line, a, c->width[l]);
+    memset(&line[c->width[l]], 0, c->across[l] * TILE_SIZE - c->width[l]);
+
+    pos = c->base[l] + (int64_t) (iy / TILE_SIZE) * c->across[l] *
+                       TILE_SIZE * TILE_SIZE + (iy % TILE_SIZE) * TILE_SIZE;
+
+    mutex_lock(&c->lock);
+
+    for (tx = 0; tx < c->across[l]; tx++)
+    {
+      file_seek(c->f, pos + (int64_t) tx * TILE_SIZE * TILE_SIZE);
+      fwrite(&line[tx * TILE_SIZE], 1, TILE_SIZE, c->f);
+    }
+
+    mutex_unlock(&c->lock);
+  }
+
+  free(line);
+  buf_free(a);
+}
+
+//=====================================================================
+
+// analyses the sound s (samplecount samples, freed) like anal() into a
+// pyramid of tiles, pooled as 'pool' says (POOL_MAX or POOL_MEAN), in
+// the file 'name'.tiles, with the index 'name'.idx ('name' having no
+// extension). Returns 0 if a file can't be created, 1 otherwise.
+
+int32_t
+anal_tiles
+(
+  real *s, int32_t samplecount, int32_t samplerate, char *name,
+  int32_t bands, double bpo, double pixpersec, double basefreq,
+  double gamma, int32_t pool
+)
+{
+  int32_t l;
+  int64_t size;
+  char *fname;
+  FILE *idx;
+  quant_t q;
+  tile_ctx_t c;
+
+  c.pool = pool;
+  c.down = (bands + TILE_SIZE - 1) / TILE_SIZE;
+  c.width[0] = anal_width(samplecount, pixpersec);
+  c.nlev = 1;
+  while (c.width[c.nlev - 1] > TILE_SIZE && c.nlev < MAX_TILE_LEVELS)
+  {
+    c.width[c.nlev] = (c.width[c.nlev - 1] + 1) / 2;
+    c.nlev++;
+  }
+
+  for (l = 0, size = 0; l < c.nlev; l++)
+  {
+    c.across[l] = (c.width[l] + TILE_SIZE - 1) / TILE_SIZE;
+    c.base[l] = size;
+    size += (int64_t) c.across[l] * c.down * TILE_SIZE * TILE_SIZE;
+  }
+
+  fname = malloc(strlen(name) + 7);
+  sprintf(fname, "%s.tiles", name);
+  c.f = fopen(fname, "wb");
+  if (c.f == NULL)
+  {
+    free(fname);
+    return 0;
+  }
+
+  file_seek(c.f, size - 1);		// the padding reads as zeros
+  fputc(0, c.f);
+
+  message("Pass 1: finding the largest value");
+  quant_init(&q, anal_rows_max(s, samplecount, bands, bpo, pixpersec,
+                               basefreq), 1.0 / gamma);
+
+  message("Pass 2: %d levels of tiles", c.nlev);
+  c.q = &q;
+  mutex_init(&c.lock);
+  anal_rows(s, samplecount, bands, bpo, pixpersec, basefreq, tile_row, &c);
+  mutex_destroy(&c.lock);
+  fclose(c.f);
+
+  sprintf(fname, "%s.idx", name);
+  idx = fopen(fname, "w");
+  free(fname);
+  if (idx == NULL)
+    return 0;
+
+  fprintf(idx, "# ASPERES tile pyramid of %s.tiles\n", name);
+  fprintf(idx, "# Level: number, columns, tiles across, offset of the "
+               "first tile\n");
+  fprintf(idx, "%-12s%d\n", "TileSize", TILE_SIZE);
+  fprintf(idx, "%-12s%d\n", "Bands", bands);
+  fprintf(idx, "%-12s%d\n", "TilesDown", c.down);
+  fprintf(idx, "%-12s%s\n", "Pooling", pool == POOL_MAX ? "max" : "mean");
+  fprintf(idx, "%-12s%.17g\n", "PixPerSec", pixpersec * samplerate);
+  fprintf(idx, "%-12s%.17g\n", "MinFreq", basefreq * samplerate);
+  fprintf(idx, "%-12s%.17g\n", "MaxFreq",
+          (logbase == 1.0 ? bpo :
+           basefreq * pow(logbase, (bands - 1) / bpo)) * samplerate);
+  fprintf(idx, "%-12s%s\n", "Scale", logbase == 1.0 ? "linear" : "log");
+  fprintf(idx, "%-12s%d\n", "Levels", c.nlev);
+  for (l = 0; l < c.nlev; l++)
+    fprintf(idx, "%-12s%d %d %d %lld\n", "Level", l, c.width[l], c.across[l],
+            (long long) c.base[l]);
+
+  fclose(idx);
+
+  return 1;
+}
@@ -0,0 +1,38 @@
+/*
+  stream.h - prototypes of the streaming analysis functions
+
+  The Analysis & Resynthesis Sound Spectrograph (ARSS)
+
+  Copyright (C) 2005-2008 Michel Rouzic
+  Copyright (C) 2010 Laszlo Menczel
+
+  This is free software distributed under the terms of the GNU General
+  Public License version 2.
+
+  This program has NO WARRANTY, you use ARSS at your own risk.
+*/
+
+#ifndef H_STREAM
+#define H_STREAM
+
+enum { POOL_MAX, POOL_MEAN };			// pooling of tile pyramids
+
+extern int32_t anal_stream(FILE * wavfile, FILE * bmpfile, int32_t channels,
+			   int32_t samplecount, int32_t bits,
+			   int32_t samplerate, int32_t bands, double bpo,
+			   double pixpersec, double basefreq, double blk_len,
+			   double gamma);
+extern int32_t anal_append(FILE * wavfile, char *bmpname, int32_t channels,
+			   int32_t samplecount, int32_t bits,
+			   int32_t samplerate, int32_t bands, double bpo,
+			   double pixpersec, double basefreq, double blk_len,
+			   double gamma);
+extern int32_t anal_pipe(real *s, int32_t samplecount, FILE * bmpfile,
+			 int32_t bands, double bpo, double pixpersec,
+			 double basefreq, double gamma);
+extern int32_t anal_tiles(real *s, int32_t samplecount, int32_t samplerate,
+			  char *name, int32_t bands, double bpo,
+			  double pixpersec, double basefreq, double gamma,
+			  int32_t pool);
+
+#endif
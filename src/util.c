@@ -22,7 +22,6 @@
 #include <stdarg.h>
 
 #include "util.h"
-#include "dsp.h"
 
 extern int32_t quiet;
 extern char *logname;
@@ -38,8 +37,19 @@ gettime()			// in milliseconds
 {
   return (int32_t) GetTickCount();
 }
+
+int32_t
+cpu_count()			// number of processors
+{
+  SYSTEM_INFO info;
+
+  GetSystemInfo(&info);
+
+  return (int32_t) info.dwNumberOfProcessors;
+}
 #else
 #include <sys/time.h>
+#include <unistd.h>
 
 int32_t
 gettime()			// in milliseconds
@@ -50,6 +60,16 @@ gettime()			// in milliseconds
 
   return (int32_t) t.tv_sec * 1000 + t.tv_usec / 1000;
 }
+
+int32_t
+cpu_count()			// number of processors
+{
+  long n;
+
+  n = sysconf(_SC_NPROCESSORS_ONLN);
+
+  return n < 1 ? 1 : (int32_t) n;
+}
 #endif
 
 //======================================================================
@@ -93,31 +113,6 @@ getfloat()
 
 //======================================================================
 
-inline int32_t
-smallprimes(int32_t x)		// returns 1 if x is only made of these small primes
-{
-  int32_t i, p[2] = { 2, 3 };
-
-  for (i = 0; i < 2; i++)
-    while (x % p[i] == 0)
-      x /= p[i];
-
-  return x;
-}
-
-//======================================================================
-
-inline int32_t
-nextsprime(int32_t x)		// returns the next integer only made of small primes
-{
-  while (smallprimes(x) != 1)
-    x++;
-
-  return x;
-}
-
-//======================================================================
-
 inline double
 log_b(double x)
 {
@@ -189,6 +184,21 @@ fread_le_word(FILE * file)	// read from file a 32-bit integer in little endian
 
 //======================================================================
 
+// seeks file to pos bytes from its start, beyond the 2 GiB a long
+// reaches on 32-bit systems. Returns 0 on success, like fseek().
+
+int32_t
+file_seek(FILE * file, int64_t pos)
+{
+#ifdef WIN32
+  return _fseeki64(file, pos, SEEK_SET);
+#else
+  return fseeko(file, (off_t) pos, SEEK_SET);
+#endif
+}
+
+//======================================================================
+
 inline void
 fwrite_le_short(uint16_t s, FILE * file)	// write to file a 16-bit integer in little endian
 {
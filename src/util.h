@@ -15,12 +15,19 @@
 #ifndef H_UTIL
 #define H_UTIL
 
+// sample type used by all signal & image buffers
+
+#ifdef ASPERES_FLOAT
+typedef float real;
+#else
+typedef double real;
+#endif
+
 extern int32_t gettime();
+extern int32_t cpu_count();
 extern double roundoff(double x);
 extern int32_t roundup(double x);
 extern float getfloat();
-extern int32_t smallprimes(int32_t x);
-extern int32_t nextsprime(int32_t x);
 extern double log_b(double x);
 extern uint32_t rand_u32();
 extern double dblrand();
@@ -28,6 +35,7 @@ extern uint16_t fread_le_short(FILE * file);
 extern uint32_t fread_le_word(FILE * file);
 extern void fwrite_le_short(uint16_t s, FILE * file);
 extern void fwrite_le_word(uint32_t w, FILE * file);
+extern int32_t file_seek(FILE * file, int64_t pos);
 extern char *getstring();
 extern int32_t str_isnumber(char *string);
 extern void message(char *fmt, ...);